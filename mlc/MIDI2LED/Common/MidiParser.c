@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief MidiParser implementation.
+ */
+
+#include <stddef.h>
+
+#include "MidiParser.h"
+
+/** Data length of status bytes which don't start a message (system exclusive, undefined). */
+#define IGNORE 0xFF
+
+/** Number of data bytes per status byte, see @ref LengthIndex. */
+static const uint8_t gs_DataLength[] =
+{
+    /* 0x80-0xE0: channel messages, by upper nibble */
+    2,      /* Note off */
+    2,      /* Note on */
+    2,      /* Polyphonic key pressure */
+    2,      /* Control change */
+    1,      /* Program change */
+    1,      /* Channel pressure */
+    2,      /* Pitch bend */
+    /* 0xF0-0xFF: system messages, by lower nibble */
+    IGNORE, /* System exclusive */
+    1,      /* MIDI time code quarter frame */
+    2,      /* Song position pointer */
+    1,      /* Song select */
+    IGNORE, /* Undefined */
+    IGNORE, /* Undefined */
+    0,      /* Tune request */
+    IGNORE, /* End of exclusive */
+    0,      /* Timing clock */
+    IGNORE, /* Undefined */
+    0,      /* Start */
+    0,      /* Continue */
+    0,      /* Stop */
+    IGNORE, /* Undefined */
+    0,      /* Active sensing */
+    0,      /* Reset */
+};
+
+static uint8_t LengthIndex(uint8_t status)
+{
+    if(status < 0xF0)
+    {
+        return (status >> 4) - 0x08;
+    }
+    return (status & 0x0F) + 7;
+}
+
+void MidiParser_Initialize(MidiParser_t *parser)
+{
+    parser->event.status = 0;
+    parser->length = 0;
+    parser->count = 0;
+}
+
+bool MidiParser_Parse(MidiParser_t *parser, uint8_t byte, MidiEvent_t *event)
+{
+    if(byte & 0x80)
+    {
+        uint8_t length = gs_DataLength[LengthIndex(byte)];
+        
+        if(byte >= 0xF8)
+        {
+            /* Real-time message. May be interleaved with any other message, so leave the state alone. */
+            if(IGNORE == length)
+            {
+                return false;
+            }
+            event->status = byte;
+            event->data[0] = 0;
+            event->data[1] = 0;
+            return true;
+        }
+        
+        /* Any other status byte starts a new message and cancels running status. */
+        parser->event.status = (IGNORE == length) ? 0 : byte;
+        parser->event.data[0] = 0;
+        parser->event.data[1] = 0;
+        parser->length = length;
+        parser->count = 0;
+        
+        if(0 != length || 0 == parser->event.status)
+        {
+            return false;
+        }
+        /* Message without data bytes. Only system common messages, no running status. */
+        *event = parser->event;
+        parser->event.status = 0;
+        return true;
+    }
+    
+    if(0 == parser->event.status)
+    {
+        /* No message in progress. */
+        return false;
+    }
+    
+    parser->event.data[parser->count++] = byte;
+    if(parser->count < parser->length)
+    {
+        return false;
+    }
+    
+    *event = parser->event;
+    parser->count = 0;
+    if(parser->event.status >= 0xF0)
+    {
+        /* Running status only applies to channel messages. */
+        parser->event.status = 0;
+    }
+    return true;
+}
+
+void MidiParser_InitializeQueueFilter(MidiQueueFilter_t *filter)
+{
+    filter->status = 0;
+    filter->left = 0;
+    filter->dropping = false;
+    filter->resync = false;
+}
+
+uint8_t MidiParser_FilterQueued(MidiQueueFilter_t *filter, uint8_t byte, uint8_t space)
+{
+    bool isStatus = (0 != (byte & 0x80));
+    uint8_t needed = 1;
+    
+    if(byte >= 0xF8)
+    {
+        /* Real-time message, not part of any other message. */
+        return (space > 0) ? 1 : 0;
+    }
+    
+    if(isStatus)
+    {
+        uint8_t length = gs_DataLength[LengthIndex(byte)];
+        
+        /* Running status only applies to channel messages. */
+        filter->status = (byte < 0xF0) ? byte : 0;
+        filter->left = (IGNORE == length) ? 0 : length;
+        filter->dropping = false;
+    }
+    else
+    {
+        if(0 == filter->left && 0 != filter->status)
+        {
+            /* Next message with running status. */
+            filter->left = gs_DataLength[LengthIndex(filter->status)];
+            filter->dropping = false;
+            if(filter->resync)
+            {
+                needed = 2;
+            }
+        }
+        if(filter->left > 0)
+        {
+            filter->left--;
+        }
+    }
+    
+    if(filter->dropping)
+    {
+        return 0;
+    }
+    if(space < needed)
+    {
+        filter->dropping = true;
+        filter->resync = true;
+        return 0;
+    }
+    if(isStatus || 2 == needed)
+    {
+        filter->resync = false;
+    }
+    return needed;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief MidiParser interface.
+ */
+
+
+#ifndef MIDIPARSER_H_
+#define MIDIPARSER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Complete MIDI message. */
+struct MidiEvent
+{
+    /** Status byte. */
+    uint8_t status;
+    
+    /** Data bytes, unused data bytes are 0. */
+    uint8_t data[2];
+};
+
+/** MIDI event type. */
+typedef struct MidiEvent MidiEvent_t;
+
+/** Parser state definition. */
+struct MidiParser
+{
+    /** Message being received. Status 0 denotes that data bytes must be ignored. */
+    MidiEvent_t event;
+    
+    /** Number of data bytes of the message being received. */
+    uint8_t length;
+    
+    /** Number of data bytes received so far. */
+    uint8_t count;
+};
+
+/** MIDI parser type. */
+typedef struct MidiParser MidiParser_t;
+
+/** Queue filter state definition, see @ref MidiParser_FilterQueued. */
+struct MidiQueueFilter
+{
+    /** Running status, 0 if there is none. */
+    uint8_t status;
+    
+    /** Number of data bytes left of the current message. */
+    uint8_t left;
+    
+    /** Whether the rest of the current message is dropped. */
+    bool dropping;
+    
+    /** Whether bytes were dropped since the last queued status byte. */
+    bool resync;
+};
+
+/** MIDI queue filter type. */
+typedef struct MidiQueueFilter MidiQueueFilter_t;
+
+/**
+ * Initialize the parser.
+ * 
+ * @param parser    The parser.
+ */
+void MidiParser_Initialize(MidiParser_t *parser);
+
+/**
+ * Feed a received byte to the parser.
+ * 
+ * Supports running status. Real-time messages are reported immediately, without affecting
+ * the message being received. System exclusive data is ignored.
+ * 
+ * @param parser    The parser.
+ * @param byte      The received byte.
+ * @param event     Output for the completed message, only written when true is returned.
+ * 
+ * @retval true     A message has been completed.
+ * @retval false    More bytes are needed.
+ */
+bool MidiParser_Parse(MidiParser_t *parser, uint8_t byte, MidiEvent_t *event);
+
+/**
+ * Initialize the queue filter.
+ * @param filter    The queue filter.
+ */
+void MidiParser_InitializeQueueFilter(MidiQueueFilter_t *filter);
+
+/**
+ * Decide how to queue a received byte for a parser, when the queue can be full.
+ * A byte which doesn't fit drops the rest of its message, so later messages never take its data bytes.
+ * With running status, the status byte is queued again before the next message, which cancels the
+ * incomplete message in the parser and keeps the running status.
+ * @param filter    The queue filter.
+ * @param byte      The received byte.
+ * @param space     Number of free places in the queue.
+ * @return  0 to drop the byte, 1 to queue the byte, 2 to queue filter->status followed by the byte.
+ */
+uint8_t MidiParser_FilterQueued(MidiQueueFilter_t *filter, uint8_t byte, uint8_t space);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIDIPARSER_H_ */
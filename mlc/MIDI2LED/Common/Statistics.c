@@ -0,0 +1,48 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief Statistics implementation.
+ */
+
+#include "Statistics.h"
+
+void Statistics_Reset(Statistics_t *statistics)
+{
+    statistics->min = UINT32_MAX;
+    statistics->max = 0;
+    statistics->sum = 0;
+    statistics->count = 0;
+}
+
+void Statistics_Add(Statistics_t *statistics, uint32_t sample)
+{
+    if(sample < statistics->min)
+    {
+        statistics->min = sample;
+    }
+    if(sample > statistics->max)
+    {
+        statistics->max = sample;
+    }
+    
+    if((UINT16_MAX == statistics->count) || (statistics->sum + sample < statistics->sum))
+    {
+        statistics->sum /= 2;
+        statistics->count /= 2;
+    }
+    statistics->sum += sample;
+    statistics->count++;
+}
+
+uint32_t Statistics_GetAverage(const Statistics_t *statistics)
+{
+    if(0 == statistics->count)
+    {
+        return 0;
+    }
+    return statistics->sum / statistics->count;
+}
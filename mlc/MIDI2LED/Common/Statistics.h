@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief Statistics interface, keeps minimum, average and maximum of a series of samples.
+ */
+
+
+#ifndef STATISTICS_H_
+#define STATISTICS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Statistics definition. */
+struct Statistics
+{
+    /** Smallest sample. */
+    uint32_t min;
+    
+    /** Largest sample. */
+    uint32_t max;
+    
+    /** Sum of the samples counted in @ref count. */
+    uint32_t sum;
+    
+    /** Number of samples in @ref sum. */
+    uint16_t count;
+};
+
+/** Statistics type. */
+typedef struct Statistics Statistics_t;
+
+/**
+ * Clear all samples.
+ * 
+ * @param statistics    The statistics.
+ */
+void Statistics_Reset(Statistics_t *statistics);
+
+/**
+ * Add a sample.
+ * 
+ * When the sum or count would overflow, both are halved. The average then gradually
+ * gives more weight to recent samples.
+ * 
+ * @param statistics    The statistics.
+ * @param sample        The sample.
+ */
+void Statistics_Add(Statistics_t *statistics, uint32_t sample);
+
+/**
+ * Get the average of the samples.
+ * 
+ * @param statistics    The statistics.
+ * 
+ * @return The average, or 0 if there are no samples.
+ */
+uint32_t Statistics_GetAverage(const Statistics_t *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATISTICS_H_ */
@@ -10,37 +10,118 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "TimerService.h"
 
-#define NUM_SLOTS 10
+#ifndef TIMERSERVICE_NUM_SLOTS
+#define TIMERSERVICE_NUM_SLOTS 10
+#endif
+
+#if TIMERSERVICE_NUM_SLOTS < 1 || TIMERSERVICE_NUM_SLOTS >= 255
+/* Slot indices are linked as uint8_t, and 255 marks a timer which is not queued. */
+#error "TIMERSERVICE_NUM_SLOTS must be 1 to 254"
+#endif
+
+#define NUM_SLOTS TIMERSERVICE_NUM_SLOTS
+
+/** End of the queue. */
+#define QUEUE_END ((uint8_t)NUM_SLOTS)
+
+/** Marks a timer which is not in the queue. */
+#define NOT_QUEUED ((uint8_t)0xFF)
+
+#ifndef TIMERSERVICE_QUEUE_SIZE
+#define TIMERSERVICE_QUEUE_SIZE 8
+#endif
+
+#if TIMERSERVICE_QUEUE_SIZE < 1 || TIMERSERVICE_QUEUE_SIZE > 128 || (TIMERSERVICE_QUEUE_SIZE & (TIMERSERVICE_QUEUE_SIZE - 1)) != 0
+/* The uint8_t request counters only wrap correctly for a power of two, and must be able to count a full queue. */
+#error "TIMERSERVICE_QUEUE_SIZE must be a power of two, at most 128"
+#endif
+
+/** Queue size, a power of two so the indices can wrap freely. */
+#define QUEUE_SIZE TIMERSERVICE_QUEUE_SIZE
+
+#ifndef TIMERSERVICE_ISR_SLOTS
+#define TIMERSERVICE_ISR_SLOTS 2
+#endif
+
+#if TIMERSERVICE_ISR_SLOTS < 1 || TIMERSERVICE_ISR_SLOTS >= TIMERSERVICE_NUM_SLOTS
+#error "TIMERSERVICE_ISR_SLOTS must be at least 1, and less than TIMERSERVICE_NUM_SLOTS"
+#endif
+
+/** First of the slots which are reserved for timers created from interrupts, the last slots. */
+#define ISR_FIRST_SLOT (NUM_SLOTS - TIMERSERVICE_ISR_SLOTS)
+#define QUEUE_MASK (QUEUE_SIZE - 1)
+
+/** Request made from an interrupt. */
+enum RequestType
+{
+    REQUEST_CREATE,
+    REQUEST_RESCHEDULE,
+    REQUEST_DELETE,
+};
+
+/** Request definition, the arguments of the function which queued it. */
+struct Request
+{
+    enum RequestType type;
+    TimerId_t timer;
+    Micros_t expiresInUs;
+    TimerCallback_t callback;
+    bool periodic;
+};
 
 /** Timer definition. */
 struct Timer
 {
     /** Expiry time. */
-    Tick_t expiresAt;
+    Micros_t expiresAt;
     
     /** Period for periodic timers. */
-    Tick_t period;
+    Micros_t period;
     
     /** Pointer to callback function. */
     TimerCallback_t callback;
+    
+    /** Next timer in the queue, @ref QUEUE_END for the last one, @ref NOT_QUEUED if not queued. */
+    uint8_t next;
 };
 
 static int FindFreeSlot();
 
-/** Pointer to function used for getting the actual tick count. */
-static GetTickFunction_t gs_GetTickFunction = NULL;
+/** Pointer to function used for getting the actual time. */
+static GetTimeFunction_t gs_GetTimeFunction = NULL;
 
 /** List of timers. */
 static struct Timer gs_Timers[NUM_SLOTS];
 
+/** First timer of the queue of running timers, ordered by expiry time. */
+static uint8_t gs_Head = QUEUE_END;
+
+/** Requests made from interrupts, written only by interrupts and read only by @ref TimerService_Run. */
+static volatile struct Request gs_Requests[QUEUE_SIZE];
+
+/** Number of requests ever queued, only written by interrupts. */
+static volatile uint8_t gs_RequestsQueued = 0;
+
+/** Number of requests ever handled, only written by @ref TimerService_Run. */
+static volatile uint8_t gs_RequestsHandled = 0;
+
+/** Number of times each slot for interrupts was claimed, only written by interrupts. */
+static volatile uint8_t gs_IsrSlotsClaimed[TIMERSERVICE_ISR_SLOTS];
+
+/** Number of times each slot for interrupts was freed, only written by the main context.
+ * A slot is free for interrupts when both counts are equal. */
+static volatile uint8_t gs_IsrSlotsFreed[TIMERSERVICE_ISR_SLOTS];
+
 static TimerId_t FindFreeSlot()
 {
     TimerId_t slot = TIMERID_INVALID;
     
-    for(int i = 0; i < NUM_SLOTS; ++i)
+    /* The last slots are only claimed by interrupts. */
+    for(int i = 0; i < ISR_FIRST_SLOT; ++i)
     {
         if(NULL == gs_Timers[i].callback)
         {
@@ -52,35 +133,114 @@ static TimerId_t FindFreeSlot()
     return slot;
 }
 
-static void Schedule(TimerId_t timer, Tick_t expiresInMs, bool periodic)
+/**
+ * Free the slot of a timer, slots for interrupts can be claimed again.
+ */
+static void Free(TimerId_t timer)
+{
+    gs_Timers[timer].callback = NULL;
+    
+    if(timer >= ISR_FIRST_SLOT)
+    {
+        uint8_t i = timer - ISR_FIRST_SLOT;
+        gs_IsrSlotsFreed[i] = gs_IsrSlotsClaimed[i];
+    }
+}
+
+static bool IsExpired(Micros_t expiresAt, Micros_t now)
+{
+    return (signed long)expiresAt - (signed long)now < 0;
+}
+
+/**
+ * Insert a timer in the queue, after all timers which expire at the same time or earlier.
+ */
+static void Enqueue(TimerId_t timer)
+{
+    Micros_t expiresAt = gs_Timers[timer].expiresAt;
+    uint8_t *pLink = &gs_Head;
+    
+    while(QUEUE_END != *pLink && !IsExpired(expiresAt, gs_Timers[*pLink].expiresAt))
+    {
+        pLink = &gs_Timers[*pLink].next;
+    }
+    
+    gs_Timers[timer].next = *pLink;
+    *pLink = (uint8_t)timer;
+}
+
+/**
+ * Remove a timer from the queue, if it is queued.
+ */
+static void Dequeue(TimerId_t timer)
+{
+    if(NOT_QUEUED == gs_Timers[timer].next)
+    {
+        return;
+    }
+    
+    uint8_t *pLink = &gs_Head;
+    
+    while(*pLink != (uint8_t)timer)
+    {
+        pLink = &gs_Timers[*pLink].next;
+    }
+    
+    *pLink = gs_Timers[timer].next;
+    gs_Timers[timer].next = NOT_QUEUED;
+}
+
+/**
+ * Convert a time in ms to us, which only fits for times up to TIMERSERVICE_MAX_MS.
+ */
+static Micros_t MsToUs(Tick_t ms)
+{
+    assert(ms <= TIMERSERVICE_MAX_MS);
+    return MS_TO_US(ms);
+}
+
+static void Schedule(TimerId_t timer, Micros_t expiresInUs, bool periodic)
 {
-    assert(NULL != gs_GetTickFunction);
-    Tick_t now = gs_GetTickFunction();
-    Tick_t period = MS_TO_TICKS(expiresInMs);
+    assert(NULL != gs_GetTimeFunction);
+    assert(expiresInUs <= TIMERSERVICE_MAX_US);
+    Micros_t now = gs_GetTimeFunction();
+    Micros_t period = expiresInUs;
     
+    Dequeue(timer);
     gs_Timers[timer].expiresAt = now + period;
     gs_Timers[timer].period    = periodic ? period : 0;
+    Enqueue(timer);
 }
 
-void TimerService_Initialize(GetTickFunction_t getTickFunction)
+void TimerService_Initialize(GetTimeFunction_t getTimeFunction)
 {
-    gs_GetTickFunction = getTickFunction;
+    gs_GetTimeFunction = getTimeFunction;
+    gs_Head = QUEUE_END;
+    
+    /* Discard requests which were queued before. */
+    gs_RequestsHandled = gs_RequestsQueued;
     
     for(int i = 0; i < NUM_SLOTS; ++i)
     {
         /* Null callback denotes a free timer slot. Other values
          * are initialized upon creating a timer. */
-        gs_Timers[i].callback = NULL;
+        Free(i);
+        gs_Timers[i].next = NOT_QUEUED;
     }
 }
 
 TimerId_t TimerService_Create(Tick_t expiresInMs, TimerCallback_t callback, bool periodic)
+{
+    return TimerService_CreateUs(MsToUs(expiresInMs), callback, periodic);
+}
+
+TimerId_t TimerService_CreateUs(Micros_t expiresInUs, TimerCallback_t callback, bool periodic)
 {
     TimerId_t newTimer = FindFreeSlot();
     
     if(TIMERID_INVALID != newTimer)
     {
-        Schedule(newTimer, expiresInMs, periodic);
+        Schedule(newTimer, expiresInUs, periodic);
         gs_Timers[newTimer].callback  = callback;
     }
     
@@ -88,12 +248,17 @@ TimerId_t TimerService_Create(Tick_t expiresInMs, TimerCallback_t callback, bool
 }
 
 void TimerService_Reschedule(TimerId_t timer, Tick_t expiresInMs, bool periodic)
+{
+    TimerService_RescheduleUs(timer, MsToUs(expiresInMs), periodic);
+}
+
+void TimerService_RescheduleUs(TimerId_t timer, Micros_t expiresInUs, bool periodic)
 {
     if(timer >= 0 && timer < NUM_SLOTS)
     {
         if(NULL != gs_Timers[timer].callback)
         {
-            Schedule(timer, expiresInMs, periodic);
+            Schedule(timer, expiresInUs, periodic);
         }
     }
 }
@@ -102,38 +267,156 @@ void TimerService_Delete(TimerId_t timer)
 {
     if(timer >= 0 && timer < NUM_SLOTS)
     {
-        gs_Timers[timer].callback = NULL;
+        if(NULL != gs_Timers[timer].callback)
+        {
+            Dequeue(timer);
+            Free(timer);
+        }
+    }
+}
+
+static bool Post(enum RequestType type, TimerId_t timer, Micros_t expiresInUs, TimerCallback_t callback, bool periodic)
+{
+    uint8_t queued = gs_RequestsQueued;
+    
+    if((uint8_t)(queued - gs_RequestsHandled) >= QUEUE_SIZE)
+    {
+        return false;
+    }
+    
+    volatile struct Request *pRequest = &gs_Requests[queued & QUEUE_MASK];
+    pRequest->type        = type;
+    pRequest->timer       = timer;
+    pRequest->expiresInUs = expiresInUs;
+    pRequest->callback    = callback;
+    pRequest->periodic    = periodic;
+    
+    /* Publish the request only after it is complete. */
+    gs_RequestsQueued = queued + 1;
+    return true;
+}
+
+TimerId_t TimerService_CreateFromIsr(Tick_t expiresInMs, TimerCallback_t callback, bool periodic)
+{
+    for(uint8_t i = 0; i < TIMERSERVICE_ISR_SLOTS; ++i)
+    {
+        uint8_t claimed = gs_IsrSlotsClaimed[i];
+        if(claimed == gs_IsrSlotsFreed[i])
+        {
+            TimerId_t timer = (TimerId_t)(ISR_FIRST_SLOT + i);
+            if(!Post(REQUEST_CREATE, timer, MsToUs(expiresInMs), callback, periodic))
+            {
+                return TIMERID_INVALID;
+            }
+            gs_IsrSlotsClaimed[i] = claimed + 1;
+            return timer;
+        }
+    }
+    
+    return TIMERID_INVALID;
+}
+
+bool TimerService_RescheduleFromIsr(TimerId_t timer, Tick_t expiresInMs, bool periodic)
+{
+    return Post(REQUEST_RESCHEDULE, timer, MsToUs(expiresInMs), NULL, periodic);
+}
+
+bool TimerService_DeleteFromIsr(TimerId_t timer)
+{
+    return Post(REQUEST_DELETE, timer, 0, NULL, false);
+}
+
+static void HandleRequests()
+{
+    uint8_t handled = gs_RequestsHandled;
+    
+    while(handled != gs_RequestsQueued)
+    {
+        struct Request request = gs_Requests[handled & QUEUE_MASK];
+        
+        /* The slot can be reused as soon as the request has been copied. */
+        gs_RequestsHandled = ++handled;
+        
+        switch(request.type)
+        {
+        case REQUEST_CREATE:
+            /* The slot was claimed by the interrupt. */
+            Schedule(request.timer, request.expiresInUs, request.periodic);
+            gs_Timers[request.timer].callback = request.callback;
+            break;
+        case REQUEST_RESCHEDULE:
+            TimerService_RescheduleUs(request.timer, request.expiresInUs, request.periodic);
+            break;
+        case REQUEST_DELETE:
+            TimerService_Delete(request.timer);
+            break;
+        }
+    }
+}
+
+bool TimerService_IsDue()
+{
+    assert(NULL != gs_GetTimeFunction);
+    
+    if(gs_RequestsHandled != gs_RequestsQueued)
+    {
+        return true;
+    }
+    
+    /* Only the first timer of the queue can have expired. */
+    return QUEUE_END != gs_Head && IsExpired(gs_Timers[gs_Head].expiresAt, gs_GetTimeFunction());
+}
+
+bool TimerService_GetNextExpiry(Micros_t *expiresAt)
+{
+    if(QUEUE_END == gs_Head)
+    {
+        return false;
     }
+    
+    *expiresAt = gs_Timers[gs_Head].expiresAt;
+    return true;
 }
 
 void TimerService_Run()
 {
-    assert(NULL != gs_GetTickFunction);
-    Tick_t now = gs_GetTickFunction();
+    assert(NULL != gs_GetTimeFunction);
     struct Timer *pTimer;
     
-    for(int i = 0; i < NUM_SLOTS; ++i)
+    HandleRequests();
+    
+    Micros_t now = gs_GetTimeFunction();
+    
+    /* The queue is ordered by expiry time, so only its head needs to be checked. */
+    while(QUEUE_END != gs_Head && IsExpired(gs_Timers[gs_Head].expiresAt, now))
     {
-        pTimer = &gs_Timers[i];
-        if(NULL != pTimer->callback)
+        TimerId_t timer = (TimerId_t)gs_Head;
+        pTimer = &gs_Timers[timer];
+        gs_Head = pTimer->next;
+        pTimer->next = NOT_QUEUED;
+        
+        /* Inform the creator. */
+        pTimer->callback(timer);
+        
+        if(NULL == pTimer->callback || NOT_QUEUED != pTimer->next)
+        {
+            /* Deleted or rescheduled by the callback. */
+        }
+        else if(pTimer->period > 0)
         {
-            if((signed long)pTimer->expiresAt - (signed long)now < 0)
+            /* Restart, one period after the previous expiry so periods do not drift. */
+            pTimer->expiresAt += pTimer->period;
+            if(IsExpired(pTimer->expiresAt, now))
             {
-                /* Inform the creator. */
-                pTimer->callback((TimerId_t)i);
-                
-                if(pTimer->period > 0)
-                {
-                    /* Restart. */
-                    pTimer->expiresAt = now + pTimer->period;
-                }
-                else
-                {
-                    /* Delete. */
-                    pTimer->callback = NULL;
-                }
+                /* Fell behind more than a period, skip the missed expiries. */
+                pTimer->expiresAt = now + pTimer->period;
             }
+            Enqueue(timer);
+        }
+        else
+        {
+            /* Delete. */
+            Free(timer);
         }
     }
 }
-
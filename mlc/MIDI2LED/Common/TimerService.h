@@ -16,28 +16,38 @@
 
 #include "../timer.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define TIMERID_INVALID ((TimerId_t)-1)
 
+/** Longest time in us after which a timer can expire. Expiry times are compared by the sign of their difference, so times must be less than 2^31 us. */
+#define TIMERSERVICE_MAX_US 0x7FFFFFFFUL
+
+/** Longest time in ms after which a timer can expire, about 35 minutes. Longer times would overflow when converted to us. */
+#define TIMERSERVICE_MAX_MS (TIMERSERVICE_MAX_US / 1000UL)
+
 /** Timer ID type. */
 typedef int TimerId_t;
 
 /** Function pointer type for timer callback functions. */
 typedef void(*TimerCallback_t)(TimerId_t);
 
-/** Function pointer type for GetTickCount functions. */
-typedef Tick_t(*GetTickFunction_t)();
+/** Function pointer type for functions which return the time in us. */
+typedef Micros_t(*GetTimeFunction_t)();
 
 /**
  * Initialize the timer service.
  * 
- * @param getTickFunction   Pointer to function which returns the actual tick count.
+ * @param getTimeFunction   Pointer to function which returns the actual time in us.
  */
-void TimerService_Initialize(GetTickFunction_t getTickFunction);
+void TimerService_Initialize(GetTimeFunction_t getTimeFunction);
 
 /**
  * Create a timer.
  * 
- * @param expiresInMs   Time in ms after which the timer should expire.
+ * @param expiresInMs   Time in ms after which the timer should expire, at most TIMERSERVICE_MAX_MS.
  * @param callback      Pointer to callback function which should be called upon expiry.
  * @param periodic      Whether the timer should be restarted with the same period after expiry.
  * 
@@ -46,15 +56,36 @@ void TimerService_Initialize(GetTickFunction_t getTickFunction);
  */
 TimerId_t TimerService_Create(Tick_t expiresInMs, TimerCallback_t callback, bool periodic);
 
+/**
+ * Create a timer with a time in us, for timing finer than a tick.
+ * 
+ * @param expiresInUs   Time in us after which the timer should expire, at most TIMERSERVICE_MAX_US.
+ * @param callback      Pointer to callback function which should be called upon expiry.
+ * @param periodic      Whether the timer should be restarted with the same period after expiry.
+ * 
+ * @retval   TIMERID_INVALID    Creating the timer failed.
+ * @retval !=TIMERID_INVALID    Timer ID of the created timer.
+ */
+TimerId_t TimerService_CreateUs(Micros_t expiresInUs, TimerCallback_t callback, bool periodic);
+
 /**
  * Reschedule a timer.
  * 
  * @param timer         Timer ID of the timer to be rescheduled.
- * @param expiresInMs   Time in ms after which the timer should expire.
+ * @param expiresInMs   Time in ms after which the timer should expire, at most TIMERSERVICE_MAX_MS.
  * @param periodic      Whether the timer should be restarted with the same period after expiry.
  */
 void TimerService_Reschedule(TimerId_t timer, Tick_t expiresInMs, bool periodic);
 
+/**
+ * Reschedule a timer with a time in us, for timing finer than a tick.
+ * 
+ * @param timer         Timer ID of the timer to be rescheduled.
+ * @param expiresInUs   Time in us after which the timer should expire, at most TIMERSERVICE_MAX_US.
+ * @param periodic      Whether the timer should be restarted with the same period after expiry.
+ */
+void TimerService_RescheduleUs(TimerId_t timer, Micros_t expiresInUs, bool periodic);
+
 /**
  * Delete (stop) an existing timer.
  * 
@@ -63,9 +94,71 @@ void TimerService_Reschedule(TimerId_t timer, Tick_t expiresInMs, bool periodic)
 void TimerService_Delete(TimerId_t timer);
 
 /**
- * Run the timer service.
+ * Create a timer from an interrupt. The timer is created by the next @ref TimerService_Run.
+ * Interrupts use the last TIMERSERVICE_ISR_SLOTS slots, which @ref TimerService_Create never returns,
+ * so the ID can be used right away with @ref TimerService_RescheduleFromIsr and @ref TimerService_DeleteFromIsr.
+ * Must be called with interrupts disabled, which is the case in an interrupt service routine.
+ * 
+ * @param expiresInMs   Time in ms after which the timer should expire, counted from @ref TimerService_Run. At most TIMERSERVICE_MAX_MS.
+ * @param callback      Pointer to callback function which should be called upon expiry.
+ * @param periodic      Whether the timer should be restarted with the same period after expiry.
+ * 
+ * @return  ID of the timer, or TIMERID_INVALID if all slots for interrupts are used or the request queue is full.
+ */
+TimerId_t TimerService_CreateFromIsr(Tick_t expiresInMs, TimerCallback_t callback, bool periodic);
+
+/**
+ * Reschedule a timer from an interrupt. The timer is rescheduled by the next @ref TimerService_Run.
+ * Must be called with interrupts disabled, which is the case in an interrupt service routine.
+ * 
+ * @param timer         Timer ID of the timer to be rescheduled.
+ * @param expiresInMs   Time in ms after which the timer should expire, counted from @ref TimerService_Run. At most TIMERSERVICE_MAX_MS.
+ * @param periodic      Whether the timer should be restarted with the same period after expiry.
+ * 
+ * @retval true     The request was queued.
+ * @retval false    The request queue is full.
+ */
+bool TimerService_RescheduleFromIsr(TimerId_t timer, Tick_t expiresInMs, bool periodic);
+
+/**
+ * Delete (stop) an existing timer from an interrupt. The timer is deleted by the next @ref TimerService_Run.
+ * Must be called with interrupts disabled, which is the case in an interrupt service routine.
+ * 
+ * @param timer Timer ID of the timer to be deleted.
+ * 
+ * @retval true     The request was queued.
+ * @retval false    The request queue is full.
+ */
+bool TimerService_DeleteFromIsr(TimerId_t timer);
+
+/**
+ * Check whether @ref TimerService_Run has work to do, so the caller can sleep otherwise.
+ * 
+ * @retval true     A timer has expired, or requests from interrupts are waiting.
+ * @retval false    No timer has expired yet.
+ */
+bool TimerService_IsDue();
+
+/**
+ * Get the expiry time of the timer which expires first, to know until when the caller can sleep.
+ * 
+ * @param[out] expiresAt    Time in us at which the first timer expires.
+ * 
+ * @retval true     A timer is running, its expiry time is stored in expiresAt.
+ * @retval false    No timer is running.
+ */
+bool TimerService_GetNextExpiry(Micros_t *expiresAt);
+
+/**
+ * Run the timer service. Handles the requests made from interrupts, then calls the callbacks of expired timers.
+ * 
+ * The other functions without FromIsr suffix must only be called from the same context as this function,
+ * never from an interrupt.
  */
 void TimerService_Run();
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* TIMERSERVICE_H_ */
@@ -0,0 +1,236 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief TimerWheel implementation.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "TimerWheel.h"
+
+/** Number of buckets per level, a power of two. */
+#define NUM_BUCKETS 64
+#define BUCKET_MASK (NUM_BUCKETS - 1)
+
+/** Ticks covered by a bucket of the second level. */
+#define LEVEL2_SHIFT 6
+
+/** Second level buckets follow the first level buckets. */
+#define LEVEL2_BUCKET(n) (NUM_BUCKETS + ((n) & BUCKET_MASK))
+
+/** Timers up to this many ticks ahead go in the second level, later timers in its last bucket. */
+#define LEVEL2_MAX_TICKS ((Tick_t)(NUM_BUCKETS - 1) << LEVEL2_SHIFT)
+
+/** End of a list. */
+#define LIST_END ((uint8_t)0xFF)
+
+/** Timer definition. */
+struct WheelTimer
+{
+    /** Expiry time. */
+    Tick_t expiresAt;
+    
+    /** Pointer to callback function, NULL for a free timer. */
+    TimerWheelCallback_t callback;
+    
+    /** Argument to pass to the callback. */
+    void *arg;
+    
+    /** Next timer in the bucket or in the free list. */
+    uint8_t next;
+    
+    /** Previous timer in the bucket, @ref LIST_END for the first one. */
+    uint8_t prev;
+    
+    /** Bucket which holds the timer. */
+    uint8_t bucket;
+};
+
+/** Pointer to function used for getting the actual tick count. */
+static Tick_t(*gs_GetTickFunction)() = NULL;
+
+/** Last tick of which the timers were handled. */
+static Tick_t gs_CurrentTick;
+
+/** Timers. */
+static struct WheelTimer gs_Timers[TIMERWHEEL_NUM_TIMERS];
+
+/** First timer of each bucket, the buckets of both levels. */
+static uint8_t gs_Buckets[2 * NUM_BUCKETS];
+
+/** First free timer. */
+static uint8_t gs_Free = LIST_END;
+
+/** Number of running timers. */
+static uint8_t gs_Running = 0;
+
+static void Link(uint8_t timer, uint8_t bucket)
+{
+    struct WheelTimer *pTimer = &gs_Timers[timer];
+    pTimer->bucket = bucket;
+    pTimer->prev = LIST_END;
+    pTimer->next = gs_Buckets[bucket];
+    if(LIST_END != pTimer->next)
+    {
+        gs_Timers[pTimer->next].prev = timer;
+    }
+    gs_Buckets[bucket] = timer;
+}
+
+static void Unlink(uint8_t timer)
+{
+    struct WheelTimer *pTimer = &gs_Timers[timer];
+    if(LIST_END == pTimer->prev)
+    {
+        gs_Buckets[pTimer->bucket] = pTimer->next;
+    }
+    else
+    {
+        gs_Timers[pTimer->prev].next = pTimer->next;
+    }
+    if(LIST_END != pTimer->next)
+    {
+        gs_Timers[pTimer->next].prev = pTimer->prev;
+    }
+}
+
+/**
+ * Put a timer in the bucket for its expiry time.
+ * 
+ * @param timer     The timer.
+ * @param minTicks  Minimum number of ticks from the current tick, timers which expire earlier go in that bucket.
+ */
+static void Place(uint8_t timer, Tick_t minTicks)
+{
+    Tick_t expiresAt = gs_Timers[timer].expiresAt;
+    signed long ticks = (signed long)expiresAt - (signed long)gs_CurrentTick;
+    
+    if(ticks < (signed long)minTicks)
+    {
+        Link(timer, (gs_CurrentTick + minTicks) & BUCKET_MASK);
+    }
+    else if(ticks < NUM_BUCKETS)
+    {
+        Link(timer, expiresAt & BUCKET_MASK);
+    }
+    else if(ticks < (signed long)LEVEL2_MAX_TICKS)
+    {
+        Link(timer, LEVEL2_BUCKET(expiresAt >> LEVEL2_SHIFT));
+    }
+    else
+    {
+        /* Too far ahead, placed again when the bucket comes around. */
+        Link(timer, LEVEL2_BUCKET((gs_CurrentTick >> LEVEL2_SHIFT) + NUM_BUCKETS - 1));
+    }
+}
+
+void TimerWheel_Initialize(Tick_t(*getTickFunction)())
+{
+    gs_GetTickFunction = getTickFunction;
+    gs_CurrentTick = getTickFunction();
+    
+    for(int i = 0; i < 2 * NUM_BUCKETS; ++i)
+    {
+        gs_Buckets[i] = LIST_END;
+    }
+    
+    /* All timers are free. */
+    gs_Running = 0;
+    gs_Free = LIST_END;
+    for(int i = TIMERWHEEL_NUM_TIMERS - 1; i >= 0; --i)
+    {
+        gs_Timers[i].callback = NULL;
+        gs_Timers[i].next = gs_Free;
+        gs_Free = (uint8_t)i;
+    }
+}
+
+TimerWheelId_t TimerWheel_Start(Tick_t expiresInMs, TimerWheelCallback_t callback, void *arg)
+{
+    assert(NULL != gs_GetTickFunction);
+    uint8_t timer = gs_Free;
+    
+    if(LIST_END != timer)
+    {
+        struct WheelTimer *pTimer = &gs_Timers[timer];
+        gs_Free = pTimer->next;
+        gs_Running++;
+        
+        pTimer->expiresAt = gs_GetTickFunction() + MS_TO_TICKS(expiresInMs);
+        pTimer->callback = callback;
+        pTimer->arg = arg;
+        /* A timer started from a callback must not expire in the tick being handled. */
+        Place(timer, 1);
+    }
+    
+    return timer;
+}
+
+void TimerWheel_Cancel(TimerWheelId_t timer)
+{
+    if(timer < TIMERWHEEL_NUM_TIMERS && NULL != gs_Timers[timer].callback)
+    {
+        Unlink(timer);
+        gs_Running--;
+        gs_Timers[timer].callback = NULL;
+        gs_Timers[timer].next = gs_Free;
+        gs_Free = timer;
+    }
+}
+
+bool TimerWheel_IsDue()
+{
+    assert(NULL != gs_GetTickFunction);
+    return 0 != gs_Running && gs_CurrentTick != gs_GetTickFunction();
+}
+
+void TimerWheel_Run()
+{
+    assert(NULL != gs_GetTickFunction);
+    Tick_t now = gs_GetTickFunction();
+    
+    if(0 == gs_Running)
+    {
+        /* Nothing to expire, and all buckets are empty wherever the wheel stands. */
+        gs_CurrentTick = now;
+        return;
+    }
+    
+    while(gs_CurrentTick != now)
+    {
+        gs_CurrentTick++;
+        
+        if(0 == (gs_CurrentTick & BUCKET_MASK))
+        {
+            /* Move the timers of the next 64 ticks to the first level. */
+            uint8_t bucket = LEVEL2_BUCKET(gs_CurrentTick >> LEVEL2_SHIFT);
+            uint8_t timer = gs_Buckets[bucket];
+            gs_Buckets[bucket] = LIST_END;
+            while(LIST_END != timer)
+            {
+                uint8_t next = gs_Timers[timer].next;
+                Place(timer, 0);
+                timer = next;
+            }
+        }
+        
+        /* Timers started from a callback go in later buckets, so this bucket empties. */
+        uint8_t bucket = gs_CurrentTick & BUCKET_MASK;
+        while(LIST_END != gs_Buckets[bucket])
+        {
+            uint8_t timer = gs_Buckets[bucket];
+            struct WheelTimer *pTimer = &gs_Timers[timer];
+            TimerWheelCallback_t callback = pTimer->callback;
+            void *arg = pTimer->arg;
+            
+            /* Free the timer first, so the callback can start a new one. */
+            TimerWheel_Cancel(timer);
+            callback(arg);
+        }
+    }
+}
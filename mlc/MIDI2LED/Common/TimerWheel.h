@@ -0,0 +1,91 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief TimerWheel interface, many short-lived one-shot timers with O(1) start and cancel.
+ * 
+ * Timers are kept in a hierarchical timing wheel with a resolution of one tick. The first level
+ * holds the timers of the next 64 ticks, the second level the timers up to 63 * 64 ticks ahead.
+ * Timers which expire even later are moved to the first level in rounds.
+ * 
+ * The firmware does not use the wheel yet, so the linker leaves it out of the image.
+ */
+
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef TIMERWHEEL_NUM_TIMERS
+/** Number of timers which can run at the same time, 11 bytes of RAM each. */
+#define TIMERWHEEL_NUM_TIMERS 16
+#endif
+
+#if TIMERWHEEL_NUM_TIMERS < 1 || TIMERWHEEL_NUM_TIMERS >= 255
+/* Timers are linked as uint8_t, and 255 marks the end of a list. */
+#error "TIMERWHEEL_NUM_TIMERS must be 1 to 254"
+#endif
+
+#define TIMERWHEEL_INVALID ((TimerWheelId_t)0xFF)
+
+/** Timer wheel timer ID type. */
+typedef uint8_t TimerWheelId_t;
+
+/** Function pointer type for timer wheel callback functions. */
+typedef void(*TimerWheelCallback_t)(void*);
+
+/**
+ * Initialize the timer wheel.
+ * 
+ * @param getTickFunction   Pointer to function which returns the actual tick count.
+ */
+void TimerWheel_Initialize(Tick_t(*getTickFunction)());
+
+/**
+ * Start a one-shot timer. The timer is freed when it expires, so its ID must not be used after the callback was called.
+ * 
+ * @param expiresInMs   Time in ms after which the timer should expire, at least one tick.
+ * @param callback      Pointer to callback function which should be called upon expiry.
+ * @param arg           Argument to pass to the callback, e.g. the note the timer belongs to.
+ * 
+ * @retval   TIMERWHEEL_INVALID     No free timer.
+ * @retval !=TIMERWHEEL_INVALID     Timer ID of the started timer.
+ */
+TimerWheelId_t TimerWheel_Start(Tick_t expiresInMs, TimerWheelCallback_t callback, void *arg);
+
+/**
+ * Cancel a running timer.
+ * 
+ * @param timer Timer ID of the timer to be cancelled.
+ */
+void TimerWheel_Cancel(TimerWheelId_t timer);
+
+/**
+ * Check whether @ref TimerWheel_Run has work to do, so the caller can sleep until the next tick otherwise.
+ * 
+ * @retval true     Ticks have passed which were not handled yet.
+ * @retval false    No timer expires before the next tick.
+ */
+bool TimerWheel_IsDue();
+
+/**
+ * Run the timer wheel, calls the callbacks of all expired timers.
+ */
+void TimerWheel_Run();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMERWHEEL_H_ */
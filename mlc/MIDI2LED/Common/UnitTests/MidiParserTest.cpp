@@ -0,0 +1,219 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief MidiParser unit tests.
+ */
+
+#include <chrono>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../MidiParser.h"
+
+class MidiParserTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        MidiParser_Initialize(&parser);
+    }
+    
+    /** Feed bytes to the parser, collecting the completed messages. */
+    void Parse(const std::vector<uint8_t> &bytes)
+    {
+        for(uint8_t byte : bytes)
+        {
+            MidiEvent_t event;
+            if(MidiParser_Parse(&parser, byte, &event))
+            {
+                events.push_back(event);
+            }
+        }
+    }
+    
+    void ExpectEvent(size_t index, uint8_t status, uint8_t data0, uint8_t data1)
+    {
+        ASSERT_LT(index, events.size());
+        EXPECT_EQ(status, events[index].status);
+        EXPECT_EQ(data0, events[index].data[0]);
+        EXPECT_EQ(data1, events[index].data[1]);
+    }
+    
+    /** Feed bytes through the queue filter to the parser, with the given free space in the queue per byte. */
+    void Queue(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &space)
+    {
+        MidiQueueFilter_t filter;
+        MidiParser_InitializeQueueFilter(&filter);
+        
+        for(size_t i = 0; i < bytes.size(); ++i)
+        {
+            uint8_t count = MidiParser_FilterQueued(&filter, bytes[i], space[i]);
+            if(2 == count)
+            {
+                Parse({filter.status});
+            }
+            if(count > 0)
+            {
+                Parse({bytes[i]});
+            }
+        }
+    }
+    
+    MidiParser_t parser;
+    std::vector<MidiEvent_t> events;
+};
+
+TEST_F(MidiParserTest, NoteOn)
+{
+    Parse({0x90, 60, 100});
+    
+    ASSERT_EQ(1u, events.size());
+    ExpectEvent(0, 0x90, 60, 100);
+}
+
+TEST_F(MidiParserTest, DataWithoutStatusIsIgnored)
+{
+    Parse({60, 100, 0x80, 60, 0});
+    
+    ASSERT_EQ(1u, events.size());
+    ExpectEvent(0, 0x80, 60, 0);
+}
+
+TEST_F(MidiParserTest, RunningStatus)
+{
+    Parse({0x91, 60, 100, 64, 90, 67, 0});
+    
+    ASSERT_EQ(3u, events.size());
+    ExpectEvent(0, 0x91, 60, 100);
+    ExpectEvent(1, 0x91, 64, 90);
+    ExpectEvent(2, 0x91, 67, 0);
+}
+
+TEST_F(MidiParserTest, DataLengthFromTable)
+{
+    Parse({0xC0, 5, 0xD0, 40, 0xE0, 0, 64, 0xA0, 60, 30, 0xB0, 64, 127});
+    
+    ASSERT_EQ(5u, events.size());
+    ExpectEvent(0, 0xC0, 5, 0);
+    ExpectEvent(1, 0xD0, 40, 0);
+    ExpectEvent(2, 0xE0, 0, 64);
+    ExpectEvent(3, 0xA0, 60, 30);
+    ExpectEvent(4, 0xB0, 64, 127);
+}
+
+TEST_F(MidiParserTest, RealTimeInterleaved)
+{
+    Parse({0x90, 0xF8, 60, 0xFE, 100});
+    
+    ASSERT_EQ(3u, events.size());
+    ExpectEvent(0, 0xF8, 0, 0);
+    ExpectEvent(1, 0xFE, 0, 0);
+    ExpectEvent(2, 0x90, 60, 100);
+}
+
+TEST_F(MidiParserTest, UndefinedRealTimeIgnored)
+{
+    Parse({0x90, 60, 0xF9, 0xFD, 100});
+    
+    ASSERT_EQ(1u, events.size());
+    ExpectEvent(0, 0x90, 60, 100);
+}
+
+TEST_F(MidiParserTest, SystemExclusiveIgnored)
+{
+    Parse({0xF0, 0x43, 0x10, 0x4C, 0xF7, 0x90, 60, 100});
+    
+    ASSERT_EQ(1u, events.size());
+    ExpectEvent(0, 0x90, 60, 100);
+}
+
+TEST_F(MidiParserTest, SystemCommonCancelsRunningStatus)
+{
+    Parse({0x90, 60, 100, 0xF3, 2, 64, 90, 0xF6});
+    
+    ASSERT_EQ(3u, events.size());
+    ExpectEvent(0, 0x90, 60, 100);
+    ExpectEvent(1, 0xF3, 2, 0);
+    ExpectEvent(2, 0xF6, 0, 0);
+}
+
+TEST_F(MidiParserTest, StatusCancelsIncompleteMessage)
+{
+    Parse({0x90, 60, 0x80, 60, 0});
+    
+    ASSERT_EQ(1u, events.size());
+    ExpectEvent(0, 0x80, 60, 0);
+}
+
+TEST_F(MidiParserTest, OverflowDropsOnlyMessageWithRunningStatus)
+{
+    /* No space for the velocity of the second note on. */
+    Queue({0x90, 60, 100, 64, 100, 67, 100, 64, 0, 60, 0},
+          {   9,  9,   9,  9,   0,  9,   9,  9, 9,  9, 9});
+    
+    ASSERT_EQ(4u, events.size());
+    ExpectEvent(0, 0x90, 60, 100);
+    ExpectEvent(1, 0x90, 67, 100);
+    ExpectEvent(2, 0x90, 64, 0);
+    ExpectEvent(3, 0x90, 60, 0);
+}
+
+TEST_F(MidiParserTest, OverflowOfFirstDataByteDropsWholeMessage)
+{
+    Queue({0x91, 60, 100, 64, 100, 60, 0, 64, 0},
+          {   9,  9,   9,  0,   9,  9, 9,  9, 9});
+    
+    ASSERT_EQ(3u, events.size());
+    ExpectEvent(0, 0x91, 60, 100);
+    ExpectEvent(1, 0x91, 60, 0);
+    ExpectEvent(2, 0x91, 64, 0);
+}
+
+TEST_F(MidiParserTest, OverflowOfStatusKeepsItsRunningStatus)
+{
+    Queue({0x90, 60, 100, 0x80, 60, 0, 64, 0},
+          {   9,  9,   9,    0,  9, 9,  9, 9});
+    
+    ASSERT_EQ(2u, events.size());
+    ExpectEvent(0, 0x90, 60, 100);
+    ExpectEvent(1, 0x80, 64, 0);
+}
+
+TEST_F(MidiParserTest, OverflowResyncNeedsSpaceForStatus)
+{
+    /* Only one place when the next message starts, which has to hold the repeated status too. */
+    Queue({0x90, 60, 100, 64, 100, 67, 100, 60, 0},
+          {   9,  9,   0,  1,   9,  9,   9,  9, 9});
+    
+    ASSERT_EQ(2u, events.size());
+    ExpectEvent(0, 0x90, 67, 100);
+    ExpectEvent(1, 0x90, 60, 0);
+}
+
+/** Measures the host cost per byte of a typical stream, reported as test property. */
+TEST_F(MidiParserTest, CostPerByte)
+{
+    std::vector<uint8_t> bytes;
+    for(int i = 0; i < 10000; ++i)
+    {
+        bytes.push_back(0x90);
+        bytes.push_back(i & 0x7F);
+        bytes.push_back(100);
+        bytes.push_back(i & 0x7F);
+        bytes.push_back(0);
+        bytes.push_back(0xFE);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    Parse(bytes);
+    auto end = std::chrono::steady_clock::now();
+    
+    EXPECT_EQ(30000u, events.size());
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    RecordProperty("NanosecondsPerKiloByte", (int)(ns * 1000 / (long long)bytes.size()));
+}
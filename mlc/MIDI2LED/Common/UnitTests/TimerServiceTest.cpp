@@ -0,0 +1,311 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief TimerService unit tests.
+ */
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../TimerService.h"
+
+/** Time returned to the timer service. */
+static Micros_t gs_Now;
+
+/** IDs of the timers in the order their callbacks were called. */
+static std::vector<TimerId_t> gs_Expired;
+
+static Micros_t GetTime()
+{
+    return gs_Now;
+}
+
+static void RecordCallback(TimerId_t timer)
+{
+    gs_Expired.push_back(timer);
+}
+
+static void RescheduleSelfCallback(TimerId_t timer)
+{
+    gs_Expired.push_back(timer);
+    TimerService_RescheduleUs(timer, 500, false);
+}
+
+static void DeleteSelfCallback(TimerId_t timer)
+{
+    gs_Expired.push_back(timer);
+    TimerService_Delete(timer);
+}
+
+static void CreateOtherCallback(TimerId_t timer)
+{
+    gs_Expired.push_back(timer);
+    TimerService_CreateUs(100, RecordCallback, false);
+}
+
+class TimerServiceTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        gs_Now = 1000;
+        gs_Expired.clear();
+        TimerService_Initialize(GetTime);
+    }
+    
+    /** Advance the time in steps, running the timer service after every step. */
+    void Advance(Micros_t us, Micros_t step = 1)
+    {
+        for(Micros_t i = 0; i < us; i += step)
+        {
+            gs_Now += step;
+            TimerService_Run();
+        }
+    }
+};
+
+TEST_F(TimerServiceTest, ExpiresAfterTime)
+{
+    TimerId_t timer = TimerService_Create(20, RecordCallback, false);
+    ASSERT_NE(TIMERID_INVALID, timer);
+    
+    Advance(20000, 10);
+    EXPECT_TRUE(gs_Expired.empty());
+    
+    Advance(10, 10);
+    ASSERT_EQ(1u, gs_Expired.size());
+    EXPECT_EQ(timer, gs_Expired[0]);
+    
+    /* One-shot timer is deleted after expiry. */
+    Advance(100000, 1000);
+    EXPECT_EQ(1u, gs_Expired.size());
+}
+
+TEST_F(TimerServiceTest, ExpiresInOrderOfExpiryTime)
+{
+    TimerId_t late = TimerService_CreateUs(300, RecordCallback, false);
+    TimerId_t early = TimerService_CreateUs(100, RecordCallback, false);
+    TimerId_t middle = TimerService_CreateUs(200, RecordCallback, false);
+    
+    gs_Now += 1000;
+    TimerService_Run();
+    
+    ASSERT_EQ(3u, gs_Expired.size());
+    EXPECT_EQ(early, gs_Expired[0]);
+    EXPECT_EQ(middle, gs_Expired[1]);
+    EXPECT_EQ(late, gs_Expired[2]);
+}
+
+TEST_F(TimerServiceTest, EqualExpiryKeepsOrderOfScheduling)
+{
+    TimerId_t first = TimerService_CreateUs(100, RecordCallback, false);
+    TimerId_t second = TimerService_CreateUs(100, RecordCallback, false);
+    TimerId_t third = TimerService_CreateUs(100, RecordCallback, false);
+    TimerService_RescheduleUs(first, 100, false);
+    
+    Advance(101);
+    
+    ASSERT_EQ(3u, gs_Expired.size());
+    EXPECT_EQ(second, gs_Expired[0]);
+    EXPECT_EQ(third, gs_Expired[1]);
+    EXPECT_EQ(first, gs_Expired[2]);
+}
+
+TEST_F(TimerServiceTest, DeletedTimerDoesNotExpire)
+{
+    TimerId_t deleted = TimerService_CreateUs(100, RecordCallback, false);
+    TimerId_t kept = TimerService_CreateUs(200, RecordCallback, false);
+    TimerService_Delete(deleted);
+    
+    Advance(1000);
+    
+    ASSERT_EQ(1u, gs_Expired.size());
+    EXPECT_EQ(kept, gs_Expired[0]);
+}
+
+TEST_F(TimerServiceTest, RunsOutOfSlots)
+{
+    /* Two of the ten slots are reserved for interrupts. */
+    for(int i = 0; i < 8; ++i)
+    {
+        EXPECT_NE(TIMERID_INVALID, TimerService_CreateUs(100, RecordCallback, false));
+    }
+    EXPECT_EQ(TIMERID_INVALID, TimerService_CreateUs(100, RecordCallback, false));
+    
+    EXPECT_NE(TIMERID_INVALID, TimerService_CreateFromIsr(1, RecordCallback, false));
+    EXPECT_NE(TIMERID_INVALID, TimerService_CreateFromIsr(1, RecordCallback, false));
+    EXPECT_EQ(TIMERID_INVALID, TimerService_CreateFromIsr(1, RecordCallback, false));
+}
+
+TEST_F(TimerServiceTest, CallbackReschedulesOwnTimer)
+{
+    TimerId_t timer = TimerService_CreateUs(100, RescheduleSelfCallback, false);
+    
+    Advance(101);
+    ASSERT_EQ(1u, gs_Expired.size());
+    
+    /* Rescheduled 500 us after the first expiry, not deleted. */
+    Advance(500);
+    ASSERT_EQ(1u, gs_Expired.size());
+    Advance(1);
+    ASSERT_EQ(2u, gs_Expired.size());
+    EXPECT_EQ(timer, gs_Expired[1]);
+}
+
+TEST_F(TimerServiceTest, CallbackDeletesOwnPeriodicTimer)
+{
+    TimerService_CreateUs(100, DeleteSelfCallback, true);
+    
+    Advance(1000);
+    
+    EXPECT_EQ(1u, gs_Expired.size());
+}
+
+TEST_F(TimerServiceTest, CallbackCreatesTimer)
+{
+    TimerId_t timer = TimerService_CreateUs(100, CreateOtherCallback, false);
+    
+    Advance(101);
+    ASSERT_EQ(1u, gs_Expired.size());
+    
+    Advance(101);
+    ASSERT_EQ(2u, gs_Expired.size());
+    /* The expired one-shot timer is only freed after its callback, so the new timer has another slot. */
+    EXPECT_NE(timer, gs_Expired[1]);
+    
+    Advance(1000);
+    EXPECT_EQ(2u, gs_Expired.size());
+}
+
+TEST_F(TimerServiceTest, PeriodicRestartDoesNotDrift)
+{
+    std::vector<Micros_t> expiries;
+    TimerService_CreateUs(1000, RecordCallback, true);
+    
+    /* Handled late every time, in steps of 7 us. */
+    for(int i = 0; i < 10000; ++i)
+    {
+        gs_Now += 7;
+        size_t count = gs_Expired.size();
+        TimerService_Run();
+        if(gs_Expired.size() != count)
+        {
+            expiries.push_back(gs_Now);
+        }
+    }
+    
+    ASSERT_EQ(69u, expiries.size());
+    /* Every expiry is within one step after a whole number of periods. */
+    for(size_t i = 0; i < expiries.size(); ++i)
+    {
+        Micros_t due = 1000 + (i + 1) * 1000;
+        EXPECT_GT(expiries[i], due);
+        EXPECT_LE(expiries[i], due + 7);
+    }
+}
+
+TEST_F(TimerServiceTest, PeriodicSkipsMissedExpiries)
+{
+    TimerService_CreateUs(100, RecordCallback, true);
+    
+    gs_Now += 1000;
+    TimerService_Run();
+    EXPECT_EQ(1u, gs_Expired.size());
+    
+    gs_Now += 100;
+    TimerService_Run();
+    EXPECT_EQ(1u, gs_Expired.size());
+    
+    gs_Now += 1;
+    TimerService_Run();
+    EXPECT_EQ(2u, gs_Expired.size());
+}
+
+TEST_F(TimerServiceTest, RequestsFromIsrHandledByRun)
+{
+    TimerId_t timer = TimerService_CreateUs(100, RecordCallback, true);
+    
+    EXPECT_TRUE(TimerService_DeleteFromIsr(timer));
+    TimerId_t fromIsr = TimerService_CreateFromIsr(1, RecordCallback, false);
+    EXPECT_NE(TIMERID_INVALID, fromIsr);
+    EXPECT_NE(timer, fromIsr);
+    EXPECT_TRUE(TimerService_IsDue());
+    
+    TimerService_Run();
+    EXPECT_FALSE(TimerService_IsDue());
+    
+    Advance(1001);
+    ASSERT_EQ(1u, gs_Expired.size());
+    EXPECT_EQ(fromIsr, gs_Expired[0]);
+}
+
+TEST_F(TimerServiceTest, TimerFromIsrDeletedBeforeCreated)
+{
+    /* The ID can be used before the next run has created the timer. */
+    TimerId_t timer = TimerService_CreateFromIsr(1, RecordCallback, true);
+    ASSERT_NE(TIMERID_INVALID, timer);
+    EXPECT_TRUE(TimerService_DeleteFromIsr(timer));
+    
+    Advance(5000, 10);
+    EXPECT_EQ(0u, gs_Expired.size());
+    
+    /* The deleted slot can be claimed again. */
+    EXPECT_EQ(timer, TimerService_CreateFromIsr(1, RecordCallback, false));
+}
+
+TEST_F(TimerServiceTest, SlotFromIsrFreedAfterExpiry)
+{
+    TimerId_t first = TimerService_CreateFromIsr(1, RecordCallback, false);
+    TimerId_t second = TimerService_CreateFromIsr(1, RecordCallback, false);
+    EXPECT_EQ(TIMERID_INVALID, TimerService_CreateFromIsr(1, RecordCallback, false));
+    
+    Advance(2000, 10);
+    ASSERT_EQ(2u, gs_Expired.size());
+    
+    EXPECT_EQ(first, TimerService_CreateFromIsr(1, RecordCallback, false));
+    EXPECT_EQ(second, TimerService_CreateFromIsr(1, RecordCallback, false));
+}
+
+TEST_F(TimerServiceTest, LongestTimeInMs)
+{
+    TimerService_Create(TIMERSERVICE_MAX_MS, RecordCallback, false);
+    
+    Advance(1000000, 1000);
+    EXPECT_EQ(0u, gs_Expired.size());
+    
+    gs_Now = 1000 + TIMERSERVICE_MAX_MS * 1000UL;
+    TimerService_Run();
+    EXPECT_EQ(0u, gs_Expired.size());
+    
+    gs_Now += 1;
+    TimerService_Run();
+    EXPECT_EQ(1u, gs_Expired.size());
+}
+
+#ifndef NDEBUG
+TEST_F(TimerServiceTest, TooLongTimeInMsAsserts)
+{
+    EXPECT_DEATH(TimerService_Create(TIMERSERVICE_MAX_MS + 1, RecordCallback, false), "");
+    EXPECT_DEATH(TimerService_Reschedule(0, TIMERSERVICE_MAX_MS + 1, false), "");
+}
+#endif
+
+TEST_F(TimerServiceTest, NextExpiry)
+{
+    Micros_t expiresAt;
+    EXPECT_FALSE(TimerService_GetNextExpiry(&expiresAt));
+    
+    TimerService_CreateUs(300, RecordCallback, false);
+    TimerService_CreateUs(200, RecordCallback, false);
+    ASSERT_TRUE(TimerService_GetNextExpiry(&expiresAt));
+    EXPECT_EQ(1200u, expiresAt);
+    
+    EXPECT_FALSE(TimerService_IsDue());
+    gs_Now = 1201;
+    EXPECT_TRUE(TimerService_IsDue());
+}
@@ -0,0 +1,200 @@
+/**
+ * @file
+ * @copyright (c) Daniel Schenk, 2026
+ * This file is part of MLC: MIDI Led strip Controller.
+ * 
+ * @date 16 Oct 2026
+ * 
+ * @brief TimerWheel unit tests.
+ */
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../TimerWheel.h"
+
+/** Tick count returned to the timer wheel. */
+static Tick_t gs_Ticks;
+
+/** Argument and tick of every callback, in the order they were called. */
+static std::vector<std::pair<uintptr_t, Tick_t> > gs_Expired;
+
+static Tick_t GetTicks()
+{
+    return gs_Ticks;
+}
+
+static void RecordCallback(void *arg)
+{
+    gs_Expired.push_back(std::make_pair((uintptr_t)arg, gs_Ticks));
+}
+
+static void RestartCallback(void *arg)
+{
+    RecordCallback(arg);
+    TimerWheel_Start(0, RecordCallback, (void *)((uintptr_t)arg + 1));
+}
+
+class TimerWheelTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        gs_Ticks = 1000;
+        gs_Expired.clear();
+        TimerWheel_Initialize(GetTicks);
+    }
+    
+    /** Advance the tick count one tick at a time, running the wheel after every tick. */
+    void Advance(Tick_t ticks)
+    {
+        for(Tick_t i = 0; i < ticks; ++i)
+        {
+            gs_Ticks++;
+            TimerWheel_Run();
+        }
+    }
+    
+    /** Start a timer which records its argument, with the delay as argument. */
+    TimerWheelId_t Start(Tick_t ticks)
+    {
+        return TimerWheel_Start(TICKS_TO_MS(ticks), RecordCallback, (void *)(uintptr_t)ticks);
+    }
+    
+    /** Check that every timer expired exactly at the tick it was started for, counted from start. */
+    void ExpectOnTime(Tick_t start)
+    {
+        for(size_t i = 0; i < gs_Expired.size(); ++i)
+        {
+            EXPECT_EQ(start + gs_Expired[i].first, gs_Expired[i].second) << "timer of " << gs_Expired[i].first << " ticks";
+        }
+    }
+};
+
+TEST_F(TimerWheelTest, ExpiresAtTick)
+{
+    Start(5);
+    
+    Advance(4);
+    EXPECT_TRUE(gs_Expired.empty());
+    Advance(1);
+    ASSERT_EQ(1u, gs_Expired.size());
+    ExpectOnTime(1000);
+}
+
+TEST_F(TimerWheelTest, ZeroDelayExpiresAtNextTick)
+{
+    Start(0);
+    TimerWheel_Run();
+    EXPECT_TRUE(gs_Expired.empty());
+    
+    Advance(1);
+    ASSERT_EQ(1u, gs_Expired.size());
+}
+
+TEST_F(TimerWheelTest, CascadesFromSecondLevel)
+{
+    const Tick_t delays[] = {63, 64, 65, 127, 128, 1000, 4000, 4031, 4032, 4100, 10000};
+    for(Tick_t delay : delays)
+    {
+        ASSERT_NE(TIMERWHEEL_INVALID, Start(delay));
+    }
+    
+    Advance(10000);
+    
+    ASSERT_EQ(sizeof(delays) / sizeof(delays[0]), gs_Expired.size());
+    ExpectOnTime(1000);
+}
+
+TEST_F(TimerWheelTest, CascadesFromAnyPhase)
+{
+    /* Start timers at every position within a second level bucket. */
+    for(Tick_t phase = 0; phase < 64; phase += 7)
+    {
+        SetUp();
+        Advance(phase);
+        Tick_t start = gs_Ticks;
+        Start(70);
+        Start(4030);
+        Advance(4100);
+        ASSERT_EQ(2u, gs_Expired.size());
+        ExpectOnTime(start);
+    }
+}
+
+TEST_F(TimerWheelTest, CatchesUpAfterMissedTicks)
+{
+    Start(3);
+    Start(200);
+    
+    gs_Ticks += 500;
+    TimerWheel_Run();
+    
+    ASSERT_EQ(2u, gs_Expired.size());
+    EXPECT_EQ(3u, gs_Expired[0].first);
+    EXPECT_EQ(200u, gs_Expired[1].first);
+}
+
+TEST_F(TimerWheelTest, Cancel)
+{
+    TimerWheelId_t cancelled = Start(10);
+    Start(10);
+    TimerWheel_Cancel(cancelled);
+    
+    /* Cancelling twice or an invalid ID does nothing. */
+    TimerWheel_Cancel(cancelled);
+    TimerWheel_Cancel(TIMERWHEEL_INVALID);
+    
+    Advance(20);
+    EXPECT_EQ(1u, gs_Expired.size());
+}
+
+TEST_F(TimerWheelTest, PassesArgument)
+{
+    TimerWheel_Start(10, RecordCallback, (void *)(uintptr_t)42);
+    
+    Advance(1);
+    ASSERT_EQ(1u, gs_Expired.size());
+    EXPECT_EQ(42u, gs_Expired[0].first);
+}
+
+TEST_F(TimerWheelTest, RunsOutOfTimers)
+{
+    for(int i = 0; i < TIMERWHEEL_NUM_TIMERS; ++i)
+    {
+        ASSERT_NE(TIMERWHEEL_INVALID, Start(5));
+    }
+    EXPECT_EQ(TIMERWHEEL_INVALID, Start(5));
+    
+    /* Expired timers are free again. */
+    Advance(5);
+    EXPECT_NE(TIMERWHEEL_INVALID, Start(5));
+}
+
+TEST_F(TimerWheelTest, StartFromCallbackExpiresNextTick)
+{
+    TimerWheel_Start(TICKS_TO_MS(2), RestartCallback, (void *)(uintptr_t)1);
+    
+    Advance(2);
+    ASSERT_EQ(1u, gs_Expired.size());
+    
+    Advance(1);
+    ASSERT_EQ(2u, gs_Expired.size());
+    EXPECT_EQ(2u, gs_Expired[1].first);
+    EXPECT_EQ(1003u, gs_Expired[1].second);
+}
+
+TEST_F(TimerWheelTest, IsDueOnlyWithRunningTimers)
+{
+    Advance(1);
+    gs_Ticks++;
+    EXPECT_FALSE(TimerWheel_IsDue());
+    
+    Start(1);
+    EXPECT_TRUE(TimerWheel_IsDue());
+    TimerWheel_Run();
+    EXPECT_FALSE(TimerWheel_IsDue());
+}
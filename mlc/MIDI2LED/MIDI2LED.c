@@ -21,6 +21,7 @@
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <avr/wdt.h>
+#include <avr/sleep.h>
 #include <util/delay.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -45,21 +46,17 @@ FUSES =
 static TimerId_t gs_dimTimer = TIMERID_INVALID;
 static TimerId_t gs_midiIndicatorTimer = TIMERID_INVALID;
 
-static Tick_t g_tick_count = 0;
-
 static volatile bool gs_midiReceived = false;
 
+/** Set by the tick interrupt when the LED after effects need to be rendered. */
+static volatile bool gs_renderDue = false;
+
 /** Last preset, preserved across reboots (provided that power supply was stable enough to preserve SRAM),
  * an XOR'ed value is kept too to be able to do an extra check.
  */
 static uint8_t g_lastPreset __attribute__((section(".noinit")));
 static uint8_t g_lastPresetCheck __attribute__((section(".noinit")));
 
-static Tick_t GetTickCount()
-{
-    return g_tick_count;
-}
-
 void toggleHeartBeatLed()
 {
 	static unsigned char heartBeadLed = 0;
@@ -118,10 +115,6 @@ static void DisplayPresetChangedCallback(void *arg)
 	g_lastPreset = newPreset;
 	g_lastPresetCheck = newPreset ^ LAST_PRESET_XOR_MASK;
 
-#warning "TODO: Remove this dirty workaround"
-    /* The display driver needs interrupts. */
-    sei();
-
     displayLedMode(newPreset);
 
     /* Bump brightness */
@@ -202,7 +195,7 @@ int main(void)
 	#else
 	//---------------------DEFAULT OR DEBUG BUILD-------------------------------
     ConfigurationModel_Initialize();
-    TimerService_Initialize(GetTickCount);
+    TimerService_Initialize(timerGetMicros);
 
 	ledInit();
 	midiInit();
@@ -257,6 +250,9 @@ int main(void)
 	/* Enables the tick interrupt which triggers periodic events */
 	timerInit();
 
+	/* Idle sleep keeps the timers, USART and SPI running, so any of their interrupts wakes the CPU */
+	set_sleep_mode(SLEEP_MODE_IDLE);
+
     /* Initial dim */
     gs_dimTimer = TimerService_Create(5000, DisplayDimTimerCallback, false);
 
@@ -267,6 +263,26 @@ int main(void)
         /* Service the timers */
         TimerService_Run();
 
+        /* Only compose a new LED frame when there is something to render, or
+         * when the LED writer needs the next frame of a dithered fade */
+        if (midiEventsPending() || gs_renderDue || ledDitherPending())
+        {
+            /* Handle MIDI input received since the last pass */
+            midiProcessInput();
+
+            if (gs_renderDue)
+            {
+                gs_renderDue = false;
+                /* Nothing to render while no LED is fading or animating */
+                if (ledAnimating())
+                {
+                    ledRenderAfterEffects();
+                }
+            }
+
+            ledFrameCommit();
+        }
+
 		if (gs_midiReceived)
 		{
 			gs_midiReceived = false;
@@ -281,7 +297,31 @@ int main(void)
 			}
 		}
 
-		asm("NOP"); //"No operation" to overcome strange behavior (program pointer stuck at previous statement)
+		/* Sleep until the next interrupt, unless there is work left. Interrupts are disabled while checking,
+		 * and only enabled again by the instruction before sleeping, so an interrupt arriving in between
+		 * wakes the CPU right away instead of being missed until the next tick. */
+		cli();
+		if (!midiEventsPending() && !gs_renderDue && !ledDitherPending() && !gs_midiReceived
+			&& !TimerService_IsDue())
+		{
+			/* Timers can expire between ticks, once the time has passed their expiry time */
+			Micros_t nextExpiry;
+			bool maySleep = true;
+			if (TimerService_GetNextExpiry(&nextExpiry))
+			{
+				/* Too close to sleep, the next loop runs the timer */
+				maySleep = timerWakeAt(nextExpiry + 1);
+			}
+
+			if (maySleep)
+			{
+				sleep_enable();
+				sei();
+				sleep_cpu();
+				sleep_disable();
+			}
+		}
+		sei();
     }
 
 	#endif
@@ -290,39 +330,23 @@ int main(void)
 ISR(USART0_RX_vect)
 {
 	gs_midiReceived = true;
-	#ifdef Debug
-	ledSingleColorSetLed(255,255,255,1);
-	#endif
 
-#warning "TODO: redesign this, only fill buffer from interrupt and do processing from main"
-	midiHandleByte();
-	//dummy = 0;
+	midiReceiveByte();
 
 	#if BUILD_MIDITODISPLAYTEST
 	midiDisplayNote();
 	#endif
-
-	#ifdef Debug
-	ledSingleColorSetLed(0,0,0,1);
-	#endif
 }
 
-ISR(USART1_TX_vect)
+ISR(TIMER0_COMPA_vect)
 {
-// 	#ifdef Debug
-// 	ledSingleColorSetLed(0,15,0,2);
-// 	#endif
-
-	ledWriteNextByte();
-
-// 	#ifdef Debug
-// 	ledSingleColorSetLed(0,0,0,2);
-// 	#endif
+	ledEndPause();
 }
 
-ISR(TIMER0_COMPA_vect)
+/* Wake-up between ticks, see timerWakeAt */
+ISR(TIMER1_COMPB_vect)
 {
-	ledEndPause();
+	timerWakeUp();
 }
 
 /* Tick interrupt */
@@ -330,6 +354,10 @@ ISR(TIMER1_COMPA_vect)
 {
 	static uint8_t renderFreqDiv = 0;
 	static uint8_t heartBeatLedCount = 0;
+
+	/* First, so timestamps taken from here on are correct */
+	timerTick();
+
 	#if BUILD_DISPLAY
 	heartBeatLedCount++;
 
@@ -341,7 +369,7 @@ ISR(TIMER1_COMPA_vect)
 	#endif
 	if(renderFreqDiv == 3)
 	{
-		ledRenderAfterEffects(ConfigurationModel_GetCurrentPreset());
+		gs_renderDue = true;
 	}
 
 	if(renderFreqDiv >= 3)
@@ -353,8 +381,5 @@ ISR(TIMER1_COMPA_vect)
 		renderFreqDiv++;
 	}
 
-	ledWriteNextByte();
-
-	g_tick_count++;
 	sei();
 }
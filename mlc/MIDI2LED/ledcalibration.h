@@ -0,0 +1,51 @@
+/**
+* @file ledcalibration.h
+* @brief LED strip calibration definitions
+*
+* Rendering works with perceived intensities. When a frame is composed, each intensity is converted into the PWM value
+* of the strip by a gamma table, followed by a white balance factor per color, so colors which are mixed at equal
+* intensity look white. Both depend on the type of strip, which is selected at compile time.
+*
+* The current drawn by the strip is estimated from the PWM values of each frame. When it would exceed the power budget,
+* all PWM values are scaled down.
+*
+* @author Daniël Schenk
+*
+* @date 2026-10-16
+*/
+
+#ifndef LEDCALIBRATION_H_
+#define LEDCALIBRATION_H_
+
+//Supported strip types
+#define ledStripTypeUncorrected 0 //!< Intensities are written to the strip unchanged
+#define ledStripTypeWS2801 1 //!< WS2801 based strip, gamma 2.5
+
+#ifndef ledStripType
+#define ledStripType ledStripTypeWS2801 //!< Type of the connected strip
+#endif
+
+#if ledStripType == ledStripTypeUncorrected
+#define ledGammaCorrection 0 //!< Whether intensities are gamma corrected
+#define ledBalanceR 255 //!< Red white balance factor, 255 is 100%
+#define ledBalanceG 255 //!< Green white balance factor, 255 is 100%
+#define ledBalanceB 255 //!< Blue white balance factor, 255 is 100%
+#define ledFullCurrent 20 //!< Current of one color of one LED at full PWM value, in mA
+#elif ledStripType == ledStripTypeWS2801
+#define ledGammaCorrection 1
+//Typical values, green and blue are brighter than red at the same PWM value. Tune for the connected strip.
+#define ledBalanceR 255
+#define ledBalanceG 200
+#define ledBalanceB 180
+#define ledFullCurrent 20
+#else
+#error "Unsupported ledStripType"
+#endif
+
+#ifndef ledPowerBudget
+#define ledPowerBudget 2000 //!< Maximum current the power supply can deliver to the strip, in mA
+#endif
+
+#define ledPwmBudget ((uint32_t)ledPowerBudget * 255 / ledFullCurrent) //!< Maximum sum of the PWM values of a frame
+
+#endif /* LEDCALIBRATION_H_ */
@@ -14,10 +14,16 @@
 #include "ledstrip.h"
 #include "BV4513.h"
 #include "midi.h"
+#include "ledtopology.h"
+#include "ledcalibration.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #define MAX_INTENSITY UINT8_MAX
 #define NUM_ELEMENTS(array) (sizeof(array) / sizeof(array[0]))
@@ -36,7 +42,6 @@ typedef struct
 
 typedef enum
 {
-	MODE_START_NO_SUSTAIN = 1,
 	MODE_RED = 1,
 	MODE_GREEN = 2,
 	MODE_BLUE = 3,
@@ -44,9 +49,7 @@ typedef enum
 	MODE_CYAN = 5,
 	MODE_MAGENTA = 6,
 	MODE_WHITE = 7,
-	MODE_END_NO_SUSTAIN = 8,
 
-	MODE_START_SUSTAIN = 8,
 	MODE_RED_SUSTAIN = 8,
 	MODE_GREEN_SUSTAIN = 9,
 	MODE_BLUE_SUSTAIN = 10,
@@ -54,7 +57,10 @@ typedef enum
 	MODE_CYAN_SUSTAIN = 12,
 	MODE_MAGENTA_SUSTAIN = 13,
 	MODE_WHITE_SUSTAIN = 14,
-	MODE_END_SUSTAIN = 15,
+
+	// envelopes
+	MODE_WHITE_PAD = 15,
+	MODE_WHITE_PIANO = 16,
 
 	// specials
 	MODE_COPYRIGHT = 50,
@@ -65,6 +71,18 @@ typedef enum
 
 	// tests
 	MODE_FULL_STRIP_COLOR_CYCLE_TEST,
+
+	// gradients
+	MODE_RAINBOW = 60,
+	MODE_VELOCITY_FIRE = 61,
+	MODE_PITCH_CLASS = 62,
+	MODE_RAINBOW_TIME = 63,
+
+	// spatial
+	MODE_RIPPLE = 64,
+
+	// harmony
+	MODE_CHORD = 65,
 } Mode;
 
 static const Color ledTestColors[] = {
@@ -87,53 +105,479 @@ static void LedTestTimerCallback(TimerId_t unused)
 }
 
 /**
-* This method can be used to change the LED effect mode, and sets the corresponding intensity value for each mode.
+* This method can be used to change the LED effect mode. Looks up the effect of the mode, which handles all rendering until the next mode change.
 * @param modeNr The LED effect mode number.
 */
 static void ledModeChange(unsigned int modeNr);
 
-static uint8_t ledMapping[88]; //!<Note number to LED number mapping. mapping[noteNr]==ledNr
+static void ledStartFrame(void);
+
+static uint8_t ledMapping[88]; //!<Note number to LED number mapping. mapping[noteNr]==ledNr. Notes without LED map to ledUnmapped.
+
+static volatile enum ledWriteStateEnum ledWriteState = idle;
+
+#define ledUnmapped ledCount //!<LED number of notes without LED. There is room for it, but it is not written, so rendering needs no checks.
+
+/** Intensity values of all LEDs, in the order they are sent to the strip */
+typedef struct
+{
+	uint8_t data[ledCount * ledBytesPerLed];
+} LedFrame;
+
+/** Intensity levels of all LEDs in 8.8 fixed point, in the same order as the frame. Rendering works on these, @ref ledFrameCommit converts them into a frame. */
+static uint16_t ledLevels[(ledCount + 1) * ledBytesPerLed];
+
+#define ledLevel(intensity) ((uint16_t)(intensity) << 8) //!<Level of an 8-bit intensity
+#define ledIntensity(level) ((uint8_t)((level) >> 8)) //!<8-bit intensity of a level
+
+#define ledR(ledNr) (ledLevels[(ledNr) * ledBytesPerLed + ledOffsetR]) //!<Red level of an LED
+#define ledG(ledNr) (ledLevels[(ledNr) * ledBytesPerLed + ledOffsetG]) //!<Green level of an LED
+#define ledB(ledNr) (ledLevels[(ledNr) * ledBytesPerLed + ledOffsetB]) //!<Blue level of an LED
+
+#if ledGammaCorrection
+/** PWM value for each perceived intensity, in 8.8 fixed point */
+static const uint16_t ledGamma[256] PROGMEM = {
+	0, 0, 0, 1, 2, 4, 6, 8, 11, 15, 20, 25, 31, 38, 46, 55,
+	64, 75, 86, 99, 112, 127, 143, 159, 177, 196, 217, 238, 261, 285, 310, 336,
+	364, 393, 424, 456, 489, 524, 560, 597, 636, 677, 719, 762, 807, 854, 902, 952,
+	1004, 1057, 1111, 1168, 1226, 1286, 1347, 1410, 1475, 1542, 1611, 1681, 1753, 1827, 1903, 1981,
+	2060, 2141, 2225, 2310, 2397, 2486, 2577, 2670, 2765, 2862, 2961, 3063, 3166, 3271, 3378, 3487,
+	3599, 3712, 3828, 3946, 4066, 4188, 4312, 4438, 4567, 4698, 4831, 4966, 5104, 5244, 5386, 5530,
+	5677, 5826, 5977, 6131, 6287, 6445, 6606, 6769, 6934, 7102, 7273, 7445, 7621, 7798, 7978, 8161,
+	8346, 8533, 8724, 8916, 9111, 9309, 9509, 9712, 9917, 10125, 10335, 10549, 10764, 10983, 11204, 11427,
+	11653, 11882, 12114, 12348, 12585, 12825, 13067, 13313, 13561, 13811, 14065, 14321, 14580, 14841, 15106, 15373,
+	15644, 15917, 16192, 16471, 16753, 17037, 17324, 17615, 17908, 18204, 18503, 18804, 19109, 19417, 19728, 20041,
+	20358, 20677, 21000, 21325, 21654, 21986, 22320, 22658, 22999, 23342, 23689, 24039, 24392, 24748, 25107, 25470,
+	25835, 26204, 26575, 26950, 27328, 27709, 28094, 28481, 28872, 29266, 29663, 30063, 30467, 30873, 31283, 31697,
+	32113, 32533, 32956, 33382, 33812, 34245, 34681, 35121, 35564, 36010, 36459, 36912, 37368, 37828, 38291, 38757,
+	39227, 39700, 40177, 40657, 41140, 41627, 42118, 42611, 43109, 43609, 44113, 44621, 45132, 45647, 46165, 46687,
+	47212, 47740, 48273, 48808, 49348, 49891, 50437, 50987, 51541, 52098, 52659, 53223, 53791, 54363, 54938, 55517,
+	56099, 56686, 57275, 57869, 58466, 59067, 59672, 60280, 60892, 61507, 62127, 62750, 63377, 64008, 64642, 65280,
+};
+
+/**
+ * Calculate the PWM value of a level, interpolated between the table entries so the fraction of the level is kept
+ *
+ * @param level     The level, in 8.8 fixed point
+ * @return          The PWM value, in 8.8 fixed point
+ */
+static inline uint16_t ledApplyGamma(uint16_t level)
+{
+	uint8_t intensity = ledIntensity(level);
+	uint16_t pwm = pgm_read_word(&ledGamma[intensity]);
+	if (intensity < 255)
+	{
+		uint16_t step = pgm_read_word(&ledGamma[intensity + 1]) - pwm;
+		pwm += ((uint32_t)step * (uint8_t)level) >> 8;
+	}
+	return pwm;
+}
+#else
+#define ledApplyGamma(level) (level)
+#endif
+
+static uint8_t ledDitherError[ledCount * ledBytesPerLed]; //!<Fraction of the PWM value of each color which was not shown yet, carried to the next frame
+static uint8_t ledFractions; //!<Nonzero when the last composed frame contained PWM values with a fraction
+static Tick_t ledLevelsChangedTick; //!<Tick count at which the last frame with changed levels was composed
+
+#define ledDitherHoldTicks 5 //!<Ticks to keep dithering after the levels last changed. Longer than the render period, so fades are dithered between their steps, while static levels stop and the CPU can sleep.
+static uint16_t ledPowerScale = 256; //!<Scale factor applied to all PWM values to stay within the power budget, in 8.8 fixed point
+
+static uint8_t ledActive[(ledCount + 1 + 7) / 8]; //!<Bit per LED which is set when the LED has been written, and cleared when it has decayed to zero
+static bool ledDirty = false; //!<Whether levels changed since the last composed frame
+static uint8_t ledNotePartB[(88 + 7) / 8]; //!<Bit per note which was last played by the second part, e.g. the other section of a split keyboard
+static int16_t ledTreasureBackground = -1; //!<Background intensity applied to the silent notes in MODE_TREASURE_INTRO, -1 when it must be applied again
+
+/**
+ * Check whether a note was last played by the second part
+ *
+ * @param noteNr    The note number
+ * @return          True for the second part
+ */
+static inline bool ledIsPartB(uint8_t noteNr)
+{
+	return (ledNotePartB[noteNr >> 3] & (1 << (noteNr & 7))) != 0;
+}
+
+/**
+ * Rotate the color of a note of the second part (red to blue, green to red, blue to green), which tells the second part apart.
+ * Applied to the color before it is written, so writing a note again gives the same result.
+ *
+ * @param noteNr    The note number
+ * @param color     The color, rotated in place
+ */
+static inline void ledPartColor(uint8_t noteNr, Color* color)
+{
+	if (ledIsPartB(noteNr))
+	{
+		uint8_t r = color->r;
+		color->r = color->g;
+		color->g = color->b;
+		color->b = r;
+	}
+}
+
+/**
+ * Mark an LED as written, so the after effects and the next frame take it into account
+ *
+ * @param ledNr     The LED number
+ */
+static inline void ledMarkActive(uint8_t ledNr)
+{
+	ledActive[ledNr >> 3] |= (1 << (ledNr & 7));
+	ledDirty = true;
+}
 
-static enum ledWriteStateEnum ledWriteState = writeR;
+#define ledTopologyEntry(firstNote, noteStep, count) {firstNote, noteStep, count},
 
-static unsigned char rMax; //!< Red intensity maximum (varies according to effect mode)
-static unsigned char gMax; //!< Green intensity maximum (varies according to effect mode)
-static unsigned char bMax; //!< Blue intensity maximum (varies according to effect mode)
+/** Segments of the strip, in the order they are connected */
+static const LedSegment ledSegments[] PROGMEM = {
+	ledTopologySegments(ledTopologyEntry)
+};
 
-static uint8_t ledsR[ledsProgrammed]; //!<Red intensity values
-static uint8_t ledsG[ledsProgrammed]; //!<Green intensity values
-static uint8_t ledsB[ledsProgrammed]; //!<Blue intensity values
+static LedFrame ledFrames[2];
+static LedFrame* ledFront = &ledFrames[0]; //!<Frame being written to the strip, only used by the LED write interrupts
+static LedFrame* volatile ledBack = &ledFrames[1]; //!<Frame being rendered, only swapped by the LED write interrupts when ledBackReady is set
+static volatile bool ledBackReady = false; //!<Whether the back frame contains changes and is not being rendered, so it can be swapped
+static const uint8_t* ledTxNext; //!<Next byte of the front frame to write to the strip, only used by the LED write interrupts
+static const uint8_t* ledTxEnd; //!<End of the front frame, only used by the LED write interrupts
 
 static Color backgroundColor = {0, 0, 0};
 
-static const Color multiColorColors[] = {
-	{MAX_INTENSITY, 0, 0},
-	{0, MAX_INTENSITY, 0},
-	{0, 0, MAX_INTENSITY},
-	{MAX_INTENSITY, MAX_INTENSITY, 0},
-	{MAX_INTENSITY, 0, MAX_INTENSITY},
-	{0, MAX_INTENSITY, MAX_INTENSITY},
+/** Release times of the sustain after effect */
+typedef enum
+{
+	ledRelease500ms,
+	ledRelease1s,
+	ledRelease2s,
+	ledRelease4s,
+	ledRelease8s,
+} LedRelease;
+
+/** Decay factor per after effect frame (40 ms) for each release time, in 0.16 fixed point. Calculated as 2^(-8 * 0.04 / t), so a full level decays to below 1/256 in t seconds. */
+static const uint16_t ledReleaseFactors[] PROGMEM = {
+	[ledRelease500ms] = 42055,
+	[ledRelease1s] = 52499,
+	[ledRelease2s] = 58656,
+	[ledRelease4s] = 62001,
+	[ledRelease8s] = 63744,
+};
+
+static uint16_t ledReleaseFactor; //!<Decay factor of the current mode, see ledReleaseFactors
+
+/** Curves which translate note velocity into LED intensity */
+typedef enum
+{
+	ledCurveLinear,
+	ledCurveLog, //!<Soft notes are brighter than with the linear curve
+	ledCurveExp, //!<Soft notes are dimmer than with the linear curve
+	ledCurveFixed, //!<Full intensity for every velocity
+	ledCurveCount
+} LedVelocityCurve;
+
+/** Intensity for every MIDI velocity, for each velocity curve */
+static const uint8_t ledVelocityCurves[ledCurveCount][128] PROGMEM = {
+	[ledCurveLinear] = {
+		0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30,
+		32, 34, 36, 38, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58, 60, 62,
+		64, 66, 68, 70, 72, 74, 76, 78, 80, 82, 84, 86, 88, 90, 92, 94,
+		96, 98, 100, 102, 104, 106, 108, 110, 112, 114, 116, 118, 120, 122, 124, 126,
+		129, 131, 133, 135, 137, 139, 141, 143, 145, 147, 149, 151, 153, 155, 157, 159,
+		161, 163, 165, 167, 169, 171, 173, 175, 177, 179, 181, 183, 185, 187, 189, 191,
+		193, 195, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221, 223,
+		225, 227, 229, 231, 233, 235, 237, 239, 241, 243, 245, 247, 249, 251, 253, 255,
+	},
+	[ledCurveLog] = {
+		0, 8, 15, 21, 28, 34, 39, 45, 50, 55, 59, 64, 68, 72, 76, 80,
+		84, 88, 91, 94, 98, 101, 104, 107, 110, 113, 116, 118, 121, 124, 126, 129,
+		131, 134, 136, 138, 140, 143, 145, 147, 149, 151, 153, 155, 157, 159, 160, 162,
+		164, 166, 168, 169, 171, 173, 174, 176, 178, 179, 181, 182, 184, 185, 187, 188,
+		190, 191, 192, 194, 195, 196, 198, 199, 200, 202, 203, 204, 205, 207, 208, 209,
+		210, 211, 212, 214, 215, 216, 217, 218, 219, 220, 221, 222, 223, 224, 225, 227,
+		228, 229, 230, 231, 231, 232, 233, 234, 235, 236, 237, 238, 239, 240, 241, 242,
+		243, 243, 244, 245, 246, 247, 248, 249, 249, 250, 251, 252, 253, 253, 254, 255,
+	},
+	[ledCurveExp] = {
+		0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4, 5, 5, 6,
+		6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 13, 13, 14, 14,
+		15, 16, 16, 17, 18, 19, 19, 20, 21, 22, 23, 24, 24, 25, 26, 27,
+		28, 29, 30, 31, 32, 33, 34, 36, 37, 38, 39, 40, 42, 43, 44, 46,
+		47, 49, 50, 52, 53, 55, 56, 58, 60, 62, 63, 65, 67, 69, 71, 73,
+		75, 77, 79, 82, 84, 86, 89, 91, 93, 96, 99, 101, 104, 107, 110, 113,
+		116, 119, 122, 125, 128, 132, 135, 139, 143, 146, 150, 154, 158, 162, 166, 171,
+		175, 179, 184, 189, 194, 199, 204, 209, 214, 220, 225, 231, 237, 243, 249, 255,
+	},
+	[ledCurveFixed] = {
+		0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	},
+};
+
+/** Shapes of the envelope of a note, for modes which light notes through an envelope */
+typedef enum
+{
+	ledEnvelopeNone,
+	ledEnvelopePad, //!<Soft attack, high sustain
+	ledEnvelopePiano, //!<Instant attack, decaying to a low sustain
+	ledEnvelopeCount
+} LedEnvelopeShape;
+
+/** Envelope parameters, per after effect frame (40 ms). The release is the release time of the effect. */
+typedef struct
+{
+	uint16_t attackStep; //!<Envelope level increase per frame during attack
+	uint16_t decayFactor; //!<Factor by which the distance to the sustain level decays per frame, in 0.16 fixed point
+	uint16_t sustainLevel; //!<Envelope level while the note is held after the decay
+} LedEnvelope;
+
+static const LedEnvelope ledEnvelopes[ledEnvelopeCount] PROGMEM = {
+	[ledEnvelopeNone] = {0, 0, 0},
+	[ledEnvelopePad] = {5243, 52499, 39321}, //0.5 s attack, 1 s decay to 60%
+	[ledEnvelopePiano] = {UINT16_MAX, 58656, 16384}, //2 s decay to 25%
+};
+
+static LedEnvelope ledEnvelope; //!<Envelope of the current mode, copied from flash at mode change
+
+/** Gradients, which give a color for every index 0-255. Palettes are gradients of equally wide bands of one color. */
+typedef enum
+{
+	ledGradientRainbow,
+	ledGradientMulticolor, //!<Palette of 6 colors
+	ledGradientRedBlue, //!<Palette of red and blue
+	ledGradientFire, //!<Dark red via yellow to white
+	ledGradientCount
+} LedGradient;
+
+static const Color ledGradients[ledGradientCount][256] PROGMEM = {
+	[ledGradientRainbow] = {
+		{255, 0, 0}, {255, 6, 0}, {255, 12, 0}, {255, 18, 0}, {255, 24, 0}, {255, 30, 0}, {255, 36, 0}, {255, 42, 0},
+		{255, 48, 0}, {255, 54, 0}, {255, 60, 0}, {255, 66, 0}, {255, 72, 0}, {255, 78, 0}, {255, 84, 0}, {255, 90, 0},
+		{255, 96, 0}, {255, 102, 0}, {255, 108, 0}, {255, 114, 0}, {255, 120, 0}, {255, 126, 0}, {255, 131, 0}, {255, 137, 0},
+		{255, 143, 0}, {255, 149, 0}, {255, 155, 0}, {255, 161, 0}, {255, 167, 0}, {255, 173, 0}, {255, 179, 0}, {255, 185, 0},
+		{255, 191, 0}, {255, 197, 0}, {255, 203, 0}, {255, 209, 0}, {255, 215, 0}, {255, 221, 0}, {255, 227, 0}, {255, 233, 0},
+		{255, 239, 0}, {255, 245, 0}, {255, 251, 0}, {253, 255, 0}, {247, 255, 0}, {241, 255, 0}, {235, 255, 0}, {229, 255, 0},
+		{223, 255, 0}, {217, 255, 0}, {211, 255, 0}, {205, 255, 0}, {199, 255, 0}, {193, 255, 0}, {187, 255, 0}, {181, 255, 0},
+		{175, 255, 0}, {169, 255, 0}, {163, 255, 0}, {157, 255, 0}, {151, 255, 0}, {145, 255, 0}, {139, 255, 0}, {133, 255, 0},
+		{128, 255, 0}, {122, 255, 0}, {116, 255, 0}, {110, 255, 0}, {104, 255, 0}, {98, 255, 0}, {92, 255, 0}, {86, 255, 0},
+		{80, 255, 0}, {74, 255, 0}, {68, 255, 0}, {62, 255, 0}, {56, 255, 0}, {50, 255, 0}, {44, 255, 0}, {38, 255, 0},
+		{32, 255, 0}, {26, 255, 0}, {20, 255, 0}, {14, 255, 0}, {8, 255, 0}, {2, 255, 0}, {0, 255, 4}, {0, 255, 10},
+		{0, 255, 16}, {0, 255, 22}, {0, 255, 28}, {0, 255, 34}, {0, 255, 40}, {0, 255, 46}, {0, 255, 52}, {0, 255, 58},
+		{0, 255, 64}, {0, 255, 70}, {0, 255, 76}, {0, 255, 82}, {0, 255, 88}, {0, 255, 94}, {0, 255, 100}, {0, 255, 106},
+		{0, 255, 112}, {0, 255, 118}, {0, 255, 124}, {0, 255, 129}, {0, 255, 135}, {0, 255, 141}, {0, 255, 147}, {0, 255, 153},
+		{0, 255, 159}, {0, 255, 165}, {0, 255, 171}, {0, 255, 177}, {0, 255, 183}, {0, 255, 189}, {0, 255, 195}, {0, 255, 201},
+		{0, 255, 207}, {0, 255, 213}, {0, 255, 219}, {0, 255, 225}, {0, 255, 231}, {0, 255, 237}, {0, 255, 243}, {0, 255, 249},
+		{0, 255, 255}, {0, 249, 255}, {0, 243, 255}, {0, 237, 255}, {0, 231, 255}, {0, 225, 255}, {0, 219, 255}, {0, 213, 255},
+		{0, 207, 255}, {0, 201, 255}, {0, 195, 255}, {0, 189, 255}, {0, 183, 255}, {0, 177, 255}, {0, 171, 255}, {0, 165, 255},
+		{0, 159, 255}, {0, 153, 255}, {0, 147, 255}, {0, 141, 255}, {0, 135, 255}, {0, 129, 255}, {0, 124, 255}, {0, 118, 255},
+		{0, 112, 255}, {0, 106, 255}, {0, 100, 255}, {0, 94, 255}, {0, 88, 255}, {0, 82, 255}, {0, 76, 255}, {0, 70, 255},
+		{0, 64, 255}, {0, 58, 255}, {0, 52, 255}, {0, 46, 255}, {0, 40, 255}, {0, 34, 255}, {0, 28, 255}, {0, 22, 255},
+		{0, 16, 255}, {0, 10, 255}, {0, 4, 255}, {2, 0, 255}, {8, 0, 255}, {14, 0, 255}, {20, 0, 255}, {26, 0, 255},
+		{32, 0, 255}, {38, 0, 255}, {44, 0, 255}, {50, 0, 255}, {56, 0, 255}, {62, 0, 255}, {68, 0, 255}, {74, 0, 255},
+		{80, 0, 255}, {86, 0, 255}, {92, 0, 255}, {98, 0, 255}, {104, 0, 255}, {110, 0, 255}, {116, 0, 255}, {122, 0, 255},
+		{128, 0, 255}, {133, 0, 255}, {139, 0, 255}, {145, 0, 255}, {151, 0, 255}, {157, 0, 255}, {163, 0, 255}, {169, 0, 255},
+		{175, 0, 255}, {181, 0, 255}, {187, 0, 255}, {193, 0, 255}, {199, 0, 255}, {205, 0, 255}, {211, 0, 255}, {217, 0, 255},
+		{223, 0, 255}, {229, 0, 255}, {235, 0, 255}, {241, 0, 255}, {247, 0, 255}, {253, 0, 255}, {255, 0, 251}, {255, 0, 245},
+		{255, 0, 239}, {255, 0, 233}, {255, 0, 227}, {255, 0, 221}, {255, 0, 215}, {255, 0, 209}, {255, 0, 203}, {255, 0, 197},
+		{255, 0, 191}, {255, 0, 185}, {255, 0, 179}, {255, 0, 173}, {255, 0, 167}, {255, 0, 161}, {255, 0, 155}, {255, 0, 149},
+		{255, 0, 143}, {255, 0, 137}, {255, 0, 131}, {255, 0, 126}, {255, 0, 120}, {255, 0, 114}, {255, 0, 108}, {255, 0, 102},
+		{255, 0, 96}, {255, 0, 90}, {255, 0, 84}, {255, 0, 78}, {255, 0, 72}, {255, 0, 66}, {255, 0, 60}, {255, 0, 54},
+		{255, 0, 48}, {255, 0, 42}, {255, 0, 36}, {255, 0, 30}, {255, 0, 24}, {255, 0, 18}, {255, 0, 12}, {255, 0, 6},
+	},
+	[ledGradientMulticolor] = {
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0},
+		{0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0},
+		{0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0},
+		{0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0},
+		{0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0},
+		{0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 255, 0}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0},
+		{255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0},
+		{255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0},
+		{255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0},
+		{255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 255, 0},
+		{255, 255, 0}, {255, 255, 0}, {255, 255, 0}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255},
+		{255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255},
+		{255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255},
+		{255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255},
+		{255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255},
+		{255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {255, 0, 255}, {0, 255, 255}, {0, 255, 255},
+		{0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255},
+		{0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255},
+		{0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255},
+		{0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255},
+		{0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255}, {0, 255, 255},
+	},
+	[ledGradientRedBlue] = {
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0}, {255, 0, 0},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+		{0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255}, {0, 0, 255},
+	},
+	[ledGradientFire] = {
+		{32, 0, 0}, {35, 0, 0}, {37, 0, 0}, {40, 0, 0}, {42, 0, 0}, {45, 0, 0}, {48, 0, 0}, {50, 0, 0},
+		{53, 0, 0}, {56, 0, 0}, {58, 0, 0}, {61, 0, 0}, {63, 0, 0}, {66, 0, 0}, {69, 0, 0}, {71, 0, 0},
+		{74, 0, 0}, {77, 0, 0}, {79, 0, 0}, {82, 0, 0}, {84, 0, 0}, {87, 0, 0}, {90, 0, 0}, {92, 0, 0},
+		{95, 0, 0}, {98, 0, 0}, {100, 0, 0}, {103, 0, 0}, {105, 0, 0}, {108, 0, 0}, {111, 0, 0}, {113, 0, 0},
+		{116, 0, 0}, {119, 0, 0}, {121, 0, 0}, {124, 0, 0}, {126, 0, 0}, {129, 0, 0}, {132, 0, 0}, {134, 0, 0},
+		{137, 0, 0}, {140, 0, 0}, {142, 0, 0}, {145, 0, 0}, {147, 0, 0}, {150, 0, 0}, {153, 0, 0}, {155, 0, 0},
+		{158, 0, 0}, {161, 0, 0}, {163, 0, 0}, {166, 0, 0}, {168, 0, 0}, {171, 0, 0}, {174, 0, 0}, {176, 0, 0},
+		{179, 0, 0}, {182, 0, 0}, {184, 0, 0}, {187, 0, 0}, {189, 0, 0}, {192, 0, 0}, {195, 0, 0}, {197, 0, 0},
+		{200, 0, 0}, {203, 0, 0}, {205, 0, 0}, {208, 0, 0}, {210, 0, 0}, {213, 0, 0}, {216, 0, 0}, {218, 0, 0},
+		{221, 0, 0}, {224, 0, 0}, {226, 0, 0}, {229, 0, 0}, {231, 0, 0}, {234, 0, 0}, {237, 0, 0}, {239, 0, 0},
+		{242, 0, 0}, {245, 0, 0}, {247, 0, 0}, {250, 0, 0}, {252, 0, 0}, {255, 0, 0}, {255, 3, 0}, {255, 6, 0},
+		{255, 9, 0}, {255, 12, 0}, {255, 15, 0}, {255, 18, 0}, {255, 21, 0}, {255, 24, 0}, {255, 27, 0}, {255, 30, 0},
+		{255, 33, 0}, {255, 36, 0}, {255, 39, 0}, {255, 42, 0}, {255, 45, 0}, {255, 48, 0}, {255, 51, 0}, {255, 54, 0},
+		{255, 57, 0}, {255, 60, 0}, {255, 63, 0}, {255, 66, 0}, {255, 69, 0}, {255, 72, 0}, {255, 75, 0}, {255, 78, 0},
+		{255, 81, 0}, {255, 84, 0}, {255, 87, 0}, {255, 90, 0}, {255, 93, 0}, {255, 96, 0}, {255, 99, 0}, {255, 102, 0},
+		{255, 105, 0}, {255, 108, 0}, {255, 111, 0}, {255, 114, 0}, {255, 117, 0}, {255, 120, 0}, {255, 123, 0}, {255, 126, 0},
+		{255, 129, 0}, {255, 132, 0}, {255, 135, 0}, {255, 138, 0}, {255, 141, 0}, {255, 144, 0}, {255, 147, 0}, {255, 150, 0},
+		{255, 153, 0}, {255, 156, 0}, {255, 159, 0}, {255, 162, 0}, {255, 165, 0}, {255, 168, 0}, {255, 171, 0}, {255, 174, 0},
+		{255, 177, 0}, {255, 180, 0}, {255, 183, 0}, {255, 186, 0}, {255, 189, 0}, {255, 192, 0}, {255, 195, 0}, {255, 198, 0},
+		{255, 201, 0}, {255, 204, 0}, {255, 207, 0}, {255, 210, 0}, {255, 213, 0}, {255, 216, 0}, {255, 219, 0}, {255, 222, 0},
+		{255, 225, 0}, {255, 228, 0}, {255, 231, 0}, {255, 234, 0}, {255, 237, 0}, {255, 240, 0}, {255, 243, 0}, {255, 246, 0},
+		{255, 249, 0}, {255, 252, 0}, {255, 255, 0}, {255, 255, 3}, {255, 255, 6}, {255, 255, 9}, {255, 255, 12}, {255, 255, 15},
+		{255, 255, 18}, {255, 255, 21}, {255, 255, 24}, {255, 255, 27}, {255, 255, 30}, {255, 255, 33}, {255, 255, 36}, {255, 255, 39},
+		{255, 255, 42}, {255, 255, 45}, {255, 255, 48}, {255, 255, 51}, {255, 255, 54}, {255, 255, 57}, {255, 255, 60}, {255, 255, 63},
+		{255, 255, 66}, {255, 255, 69}, {255, 255, 72}, {255, 255, 75}, {255, 255, 78}, {255, 255, 81}, {255, 255, 84}, {255, 255, 87},
+		{255, 255, 90}, {255, 255, 93}, {255, 255, 96}, {255, 255, 99}, {255, 255, 102}, {255, 255, 105}, {255, 255, 108}, {255, 255, 111},
+		{255, 255, 114}, {255, 255, 117}, {255, 255, 120}, {255, 255, 123}, {255, 255, 126}, {255, 255, 129}, {255, 255, 132}, {255, 255, 135},
+		{255, 255, 138}, {255, 255, 141}, {255, 255, 144}, {255, 255, 147}, {255, 255, 150}, {255, 255, 153}, {255, 255, 156}, {255, 255, 159},
+		{255, 255, 162}, {255, 255, 165}, {255, 255, 168}, {255, 255, 171}, {255, 255, 174}, {255, 255, 177}, {255, 255, 180}, {255, 255, 183},
+		{255, 255, 186}, {255, 255, 189}, {255, 255, 192}, {255, 255, 195}, {255, 255, 198}, {255, 255, 201}, {255, 255, 204}, {255, 255, 207},
+		{255, 255, 210}, {255, 255, 213}, {255, 255, 216}, {255, 255, 219}, {255, 255, 222}, {255, 255, 225}, {255, 255, 228}, {255, 255, 231},
+		{255, 255, 234}, {255, 255, 237}, {255, 255, 240}, {255, 255, 243}, {255, 255, 246}, {255, 255, 249}, {255, 255, 252}, {255, 255, 255},
+	},
 };
 
+/** Number of bands of each gradient which is a palette, 0 for continuous gradients */
+static const uint8_t ledGradientBands[ledGradientCount] PROGMEM = {
+	[ledGradientMulticolor] = 6,
+	[ledGradientRedBlue] = 2,
+};
+
+static uint16_t ledSequenceStep; //!<Gradient index step from note to note in sequence, in 8.8 fixed point
+static uint16_t ledSequenceIndex; //!<Gradient index of the next note in sequence, in 8.8 fixed point
+
+/** Behaviour of an LED effect mode. The hooks are called through the copy of the current mode's effect, so handling an event is a single indirect call. */
+typedef struct
+{
+	uint8_t mode; //!<Mode number (MIDI program number)
+	Color max; //!<Intensity maximum of each color
+	LedRelease release; //!<Release time, for effects which decay
+	LedVelocityCurve curve; //!<Velocity curve
+	LedEnvelopeShape envelope; //!<Envelope, for effects which light notes through an envelope
+	LedGradient gradient; //!<Gradient, for effects which take colors from a gradient
+	void (*onNoteOn)(uint8_t noteNr); //!<Called when a note has been turned on
+	void (*onNoteOff)(uint8_t noteNr); //!<Called when a note has been turned off
+	void (*onPedal)(uint8_t sustain); //!<Called when the sustain pedal has been pressed or released, with its value
+	void (*onFrame)(void); //!<Called at a fixed interval to render after effects
+	bool (*isAnimating)(void); //!<Whether onFrame would change anything, so rendering can be skipped until the next event when it returns false
+} LedEffect;
+
+static LedEffect ledEffect; //!<Effect of the current mode, copied from flash at mode change
+static Statistics_t ledRenderTime; //!<Time needed to render the after effects
+
+static volatile bool ledEventPending = false; //!<Whether input events were rendered into the back frame
+static volatile Timestamp_t ledEventTimestamp; //!<Arrival time of the oldest input event in the back frame
+static bool ledFrameHasEvent = false; //!<Whether the front frame contains rendered input events which were not written yet
+static Timestamp_t ledFrameEventTimestamp; //!<Arrival time of the oldest input event in the front frame
+static Statistics_t ledLatency; //!<Time from input event arrival until the frame containing it has been written
+static Timestamp_t ledFrameStartTimestamp; //!<Start time of the frame being written
+static Statistics_t ledFrameTime; //!<Time needed to write a frame to the strip
+
 /**
-* This method writes the mapping of note numbers to LED numbers in memory.
+* This method writes the mapping of note numbers to LED numbers in memory, according to the topology of the strip.
 * @author Daniël Schenk
 * @date 2011-09-29
 */
 static void ledCreateMapping()
 {
-	int bottom = 0;
-	int top = 87;
-	int noteNr = 0;
-	while(noteNr<88)
+	memset(ledMapping, ledUnmapped, sizeof(ledMapping));
+
+	uint8_t ledNr = 0;
+	for (uint8_t segmentNr = 0; segmentNr < NUM_ELEMENTS(ledSegments); segmentNr++)
+	{
+		LedSegment segment;
+		memcpy_P(&segment, &ledSegments[segmentNr], sizeof(segment));
+
+		uint8_t noteNr = segment.firstNote;
+		for (uint8_t i = 0; i < segment.count; i++)
+		{
+			if (segment.firstNote != ledNoNote)
+			{
+				ledMapping[noteNr] = ledNr;
+				noteNr += segment.noteStep;
+			}
+			ledNr++;
+		}
+	}
+}
+
+/**
+* This method returns the note lit by an LED, according to the topology of the strip.
+* @param ledNr LED number
+* @return Note number, or ledNoNote if the LED doesn't light a note
+*/
+static uint8_t ledNoteOfLed(uint8_t ledNr)
+{
+	for (uint8_t segmentNr = 0; segmentNr < NUM_ELEMENTS(ledSegments); segmentNr++)
 	{
-		ledMapping[noteNr] = bottom;
-		bottom++;
-		noteNr++;
-		ledMapping[noteNr] = top;
-		top--;
-		noteNr++;
+		LedSegment segment;
+		memcpy_P(&segment, &ledSegments[segmentNr], sizeof(segment));
+
+		if (ledNr < segment.count)
+		{
+			if (segment.firstNote == ledNoNote)
+				return ledNoNote;
+			return segment.firstNote + ledNr * segment.noteStep;
+		}
+		ledNr -= segment.count;
 	}
+	return ledNoNote;
 }
 
 /**
@@ -155,7 +599,7 @@ static void ledInitUSART1SPI(long baud)
 	/* IMPORTANT: The Baud Rate must be set after the transmitter is enabled
 	*/
 	UBRR1 = (F_CPU / (2*baud)) - 1;
-	UCSR1B |= 0b01000000; /* Set TXCIE1 bit (enable transmit complete interrupts) */
+	/* Interrupts are enabled per frame, see ledStartFrame(). */
 }
 
 
@@ -167,8 +611,14 @@ static void ledInitUSART1SPI(long baud)
 void ledInit()
 {
 	ledCreateMapping();
+	Statistics_Reset(&ledLatency);
+	Statistics_Reset(&ledFrameTime);
+	Statistics_Reset(&ledRenderTime);
 	ledInitUSART1SPI(ledBaud);
-	ledWriteNextByte();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ledStartFrame();
+	}
 
     ConfigurationModel_SubscribeCurrentPreset(CurrentPresetChangedCallback);
     /* Make sure configuration is done for initial preset */
@@ -186,12 +636,10 @@ void ledInit()
  */
 static uint8_t velocityToIntensity(uint8_t velocity, uint8_t factor)
 {
-    /* MIDI velocity has range 0-127. LEDs have range 0-255. Upscale velocity first */
-    uint8_t intensity = velocity * 2;
-    /* Apply factor */
-    intensity *= (factor / 255);
-
-    return intensity;
+    /* MIDI velocity has range 0-127. LEDs have range 0-255. The curve upscales it */
+    uint8_t intensity = pgm_read_byte(&ledVelocityCurves[ledEffect.curve][velocity & 0x7F]);
+    /* Apply factor. Multiplying by factor + 1 keeps full intensity at factor 255, and needs no division */
+    return ((uint16_t)intensity * (factor + 1)) >> 8;
 }
 
 /**
@@ -205,23 +653,24 @@ void ledSingleColorUpdateFull(uint8_t r, uint8_t g, uint8_t b)
 	for (int noteNr=0; noteNr<88; noteNr++)
 	{
         uint8_t ledNumber = ledMapping[noteNr];
-		ledsR[ledNumber] = velocityToIntensity(notes[noteNr], r);
-		ledsG[ledNumber] = velocityToIntensity(notes[noteNr], g);
-		ledsB[ledNumber] = velocityToIntensity(notes[noteNr], b);
+		ledMarkActive(ledNumber);
+		ledR(ledNumber) = ledLevel(velocityToIntensity(notes[noteNr], r));
+		ledG(ledNumber) = ledLevel(velocityToIntensity(notes[noteNr], g));
+		ledB(ledNumber) = ledLevel(velocityToIntensity(notes[noteNr], b));
 	}
 }
 
 /**
- * Overwrite the actual intensity at the given address with the new intensity if the new intensity is higher
+ * Overwrite the actual level at the given address with the new intensity if the new intensity is higher
  *
- * @param actualIntensity   Pointer to the actual intensity
+ * @param actualLevel       Pointer to the actual level
  * @param newIntensity      The new intensity
  */
-static void applyNewIntensityIfHigher(uint8_t* actualIntensity, uint8_t newIntensity)
+static void applyNewIntensityIfHigher(uint16_t* actualLevel, uint8_t newIntensity)
 {
-    if(newIntensity > *actualIntensity)
+    if(ledLevel(newIntensity) > *actualLevel)
     {
-        *actualIntensity = newIntensity;
+        *actualLevel = ledLevel(newIntensity);
     }
 }
 
@@ -236,39 +685,31 @@ void ledSingleColorUpdateLedOn(uint8_t r, uint8_t g, uint8_t b, uint8_t noteNr)
 {
     uint8_t velocity = notes[noteNr];
     uint8_t ledNumber = ledMapping[noteNr];
-    applyNewIntensityIfHigher(&ledsR[ledNumber], velocityToIntensity(velocity, r));
-    applyNewIntensityIfHigher(&ledsG[ledNumber], velocityToIntensity(velocity, g));
-    applyNewIntensityIfHigher(&ledsB[ledNumber], velocityToIntensity(velocity, b));
+    Color color = {r, g, b};
+    ledPartColor(noteNr, &color);
+    ledMarkActive(ledNumber);
+    applyNewIntensityIfHigher(&ledR(ledNumber), velocityToIntensity(velocity, color.r));
+    applyNewIntensityIfHigher(&ledG(ledNumber), velocityToIntensity(velocity, color.g));
+    applyNewIntensityIfHigher(&ledB(ledNumber), velocityToIntensity(velocity, color.b));
 }
 
 static void ledSingleColorUpdateLedOnMax(uint8_t noteNr)
 {
     uint8_t ledNumber = ledMapping[noteNr];
-    applyNewIntensityIfHigher(&ledsR[ledNumber], rMax);
-    applyNewIntensityIfHigher(&ledsG[ledNumber], gMax);
-    applyNewIntensityIfHigher(&ledsB[ledNumber], bMax);
-}
-
-static void multicolorLedOn(uint8_t noteNr)
-{
-	uint8_t velocity = notes[noteNr];
-    uint8_t ledNumber = ledMapping[noteNr];
-	static const Color* nextColor = multiColorColors;
-
-	ledsR[ledNumber] = velocityToIntensity(velocity, nextColor->r);
-	ledsG[ledNumber] = velocityToIntensity(velocity, nextColor->g);
-	ledsB[ledNumber] = velocityToIntensity(velocity, nextColor->b);
-
-	const Color* end = &multiColorColors[NUM_ELEMENTS(multiColorColors)];
-	if (++nextColor >= end)
-		nextColor = multiColorColors;
+    Color color = ledEffect.max;
+    ledPartColor(noteNr, &color);
+    ledMarkActive(ledNumber);
+    applyNewIntensityIfHigher(&ledR(ledNumber), color.r);
+    applyNewIntensityIfHigher(&ledG(ledNumber), color.g);
+    applyNewIntensityIfHigher(&ledB(ledNumber), color.b);
 }
 
 void ledSingleColorUpdateLedOff(uint8_t noteNr)
 {
-	ledsR[ledMapping[noteNr]] = backgroundColor.r;
-	ledsG[ledMapping[noteNr]] = backgroundColor.g;
-	ledsB[ledMapping[noteNr]] = backgroundColor.b;
+	ledMarkActive(ledMapping[noteNr]);
+	ledR(ledMapping[noteNr]) = ledLevel(backgroundColor.r);
+	ledG(ledMapping[noteNr]) = ledLevel(backgroundColor.g);
+	ledB(ledMapping[noteNr]) = ledLevel(backgroundColor.b);
 }
 
 /**
@@ -281,19 +722,20 @@ void ledSingleColorUpdateLedOff(uint8_t noteNr)
 */
 void ledSingleColorSetFull(int16_t r, int16_t g, int16_t b)
 {
-	for (int ledNr=0; ledNr<ledsProgrammed; ledNr++)
+	for (int ledNr=0; ledNr<ledCount; ledNr++)
 	{
+		ledMarkActive(ledNr);
 		if (r >= 0)
 		{
-			ledsR[ledNr]=(uint8_t)r;
+			ledR(ledNr) = ledLevel(r);
 		}
 		if (g >= 0)
 		{
-			ledsG[ledNr]=(uint8_t)g;
+			ledG(ledNr) = ledLevel(g);
 		}
 		if (b >= 0)
 		{
-			ledsB[ledNr]=(uint8_t)b;
+			ledB(ledNr) = ledLevel(b);
 		}
 	}
 
@@ -320,360 +762,1093 @@ static void setBackgroundColor(uint8_t r, uint8_t g, uint8_t b)
 */
 void ledSingleColorSetLed(uint8_t r, uint8_t g, uint8_t b, uint8_t ledNr)
 {
-	ledsR[ledNr]=r;
-	ledsG[ledNr]=g;
-	ledsB[ledNr]=b;
+	ledMarkActive(ledNr);
+	ledR(ledNr) = ledLevel(r);
+	ledG(ledNr) = ledLevel(g);
+	ledB(ledNr) = ledLevel(b);
 }
 
 /**
-* This method is used for writing the next following byte of intensity values to the LED strip. Interrupt based, to free up processor time. Must be used as quickly as possible since previous written byte, because the LED strip updates the LEDs after 500-800 uS of clock inactivity. When the function is called for the first time, the first byte is written. Then the function completes, and keeps track of next LED number and color that needs to be written. Other tasks can be done on the MCU. The TX complete interrupt from the USART can be used to trigger the next function call, which then writes the next byte, notes the next number and color, and so on. When all colors of all LEDs have been written, writeStripComplete is written 1, and prohibits further action of this method. Also a 800 uS timer is started. During the 800 uS, nothing may be written to the strip, to make sure the LEDs are being updated with the new intensities. The timer complete interrupt can be used to reset writeStripComplete, allowing a new write action to the strip.
-* @author Daniël Schenk
-* @date 2011-09-29
+* This method starts writing the front frame to the LED strip, after swapping in the back frame if it has been rendered. Must be called with interrupts disabled, while the writer is idle.
 */
-void ledWriteNextByte()
+static void ledStartFrame(void)
 {
-	static uint8_t currentLed=4;
-	switch (ledWriteState)
+	if (ledBackReady)
 	{
-		case writeR:
-			UDR1 = (uint8_t)ledsR[currentLed];
-			ledWriteState = writeG;
-			break;
-		case writeG:
-			UDR1 = (uint8_t)ledsG[currentLed];
-			ledWriteState = writeB;
-			break;
-		case writeB:
-			UDR1 = (uint8_t)ledsB[currentLed];
+		//Frame boundary, show the rendered frame. The back frame is composed completely from the levels, so its old contents do not matter.
+		LedFrame* rendered = ledBack;
+		ledBack = ledFront;
+		ledFront = rendered;
+		ledBackReady = false;
 
-			if (currentLed==41)
-			{
-				ledWriteState = writeR;
-				currentLed = 46;
-				break;
-			}
+		ledFrameHasEvent = ledEventPending;
+		ledFrameEventTimestamp = ledEventTimestamp;
+		ledEventPending = false;
+	}
 
-			if (currentLed==85)
-			{
-				currentLed=4;
-				ledWriteState = pause;
-				//writeStripComplete = 1;
-				TCNT0 = 0; //Reset timer value
-				TCCR0B = (1<<CS02|0<<CS01|0<<CS00); //Start timer, CLK/256
-				TIMSK0 = (1<<OCIE0A); //Enable output compare match 1 interrupt
-				OCR0A = 0xE9; //0xF9 is 800uS with 20MHz clock and 64 prescale
-				break;
-			}
-			else
-			{
-				ledWriteState = writeR;
-				currentLed++;
-				break;
-			}
-		case render: //Not used
-			ledRenderAfterEffects(ConfigurationModel_GetCurrentPreset());
-			ledWriteState = pause;
-			break;
-		case pause:
-			break;
-		default:
+	ledTxNext = &ledFront->data[0];
+	ledTxEnd = &ledFront->data[ledCount * ledBytesPerLed];
+	ledWriteState = writeFrame;
+	ledFrameStartTimestamp = timerGetTimestamp();
+
+	UCSR1B |= (1<<UDRIE1); //The data register is empty, so this triggers the first data register empty interrupt
+}
+
+/**
+* Data register empty interrupt of the LED strip USART. Writes the frame to the strip, as long as the transmit buffer of the USART has room, so the clock keeps running without gaps. Defined here instead of calling a function from MIDI2LED.c, because this runs for every byte and a call would force saving all call-clobbered registers.
+*
+* The LED strip updates the LEDs after 500-800 uS of clock inactivity, so bytes must follow each other quickly. When the whole frame is in the transmitter, the TX complete interrupt takes over.
+*/
+ISR(USART1_UDRE_vect)
+{
+	const uint8_t* next = ledTxNext;
+	do
+	{
+		UDR1 = *next++;
+		if (next == ledTxEnd)
+		{
+			//Last byte written. Clear a TX complete flag left by an earlier underrun, and wait for the last byte to be shifted out.
+			UCSR1A = (1<<TXC1);
+			UCSR1B = (UCSR1B & ~(1<<UDRIE1)) | (1<<TXCIE1);
 			break;
-	}
+		}
+	} while (UCSR1A & (1<<UDRE1));
+	ledTxNext = next;
 }
 
 /**
-* This method ends the pause period required for the LED strip to apply received values, and allows a new write cycle to start.
-* @author Daniël Schenk
-* @date 2011-12-?
+* TX complete interrupt of the LED strip USART, runs when the last byte of a frame has been shifted out. Starts the pause period which makes the strip apply the received values, after which @ref ledEndPause is called.
 */
-void ledEndPause(void)
+ISR(USART1_TX_vect)
 {
-	TCCR0B = (0<<CS02|0<<CS01|0<<CS00); //Stop timer
-	//TCNT0 = 0; //Reset timer value
-	//writeStripComplete = 0;
-	ledWriteState = writeR;
+	UCSR1B &= ~(1<<TXCIE1);
+
+	ledWriteState = pause;
+	//writeStripComplete = 1;
+	TCNT0 = 0; //Reset timer value
+	TCCR0B = (1<<CS02|0<<CS01|0<<CS00); //Start timer, CLK/256
+	TIMSK0 = (1<<OCIE0A); //Enable output compare match 1 interrupt
+	OCR0A = 0xE9; //0xF9 is 800uS with 20MHz clock and 64 prescale
+
+	Timestamp_t now = timerGetTimestamp();
+	Statistics_Add(&ledFrameTime, now - ledFrameStartTimestamp);
+	if (ledFrameHasEvent)
+	{
+		Statistics_Add(&ledLatency, now - ledFrameEventTimestamp);
+		ledFrameHasEvent = false;
+	}
 }
+
 /**
-* This method is used for rendering LED effects after turning on (e.g. dimming slowly to zero). Designed for running at a fixed interval.
-* @param mode Global LED effect mode.
-* @author Daniël Schenk
-* @date 2011-12-?
+* This method must be called after rendering an input event, to measure the latency from arrival of the event until the LED strip shows it. Must be called from the main loop, before the next @ref ledFrameCommit.
+* @param received Arrival time of the event.
 */
-void ledRenderAfterEffects(unsigned int mode)
+void ledEventRendered(Timestamp_t received)
 {
-	#define freqDiv 2
-	//Rendering LEDs happens in the same way for modes 8-14
-	if((mode >= MODE_START_SUSTAIN && mode < MODE_END_SUSTAIN)
-		|| mode == MODE_MULTICOLOR)
+	//Levels are only dirty when an event since the last committed frame changed them. Otherwise no frame is composed for the event, and its time would be reported against a later frame.
+	if (!ledDirty)
 	{
-		mode = MODE_START_SUSTAIN;
+		return;
 	}
-	uint8_t note, r, g, b;
-	bool any_on;
-	switch(mode)
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		case MODE_FULL_STRIP_COLOR_CYCLE_TEST:
-			ledSingleColorSetFull(ledTestColor->r, ledTestColor->g, ledTestColor->b);
-			break;
-		case MODE_START_SUSTAIN:
-			for (int ledNr = 0; ledNr<ledsProgrammed; ledNr++)
-			{
-				if(ledsR[ledNr]>100)
-					ledsR[ledNr] = ledsR[ledNr] - ledsR[ledNr]/100;
-				else if(ledsR[ledNr]>0/* && (ledsRcount[ledNr] % freqDiv)==0*/)
-				{
-					ledsR[ledNr]--;
-					//ledsRcount[ledNr]++;
-				}
-				//else if(ledsR[ledNr]==0)
-					//ledsRcount[ledNr] = 0;
-				if(ledsG[ledNr]>100)
-					ledsG[ledNr] = ledsG[ledNr] - ledsG[ledNr]/100;
-				else if(ledsG[ledNr]>0)
-					ledsG[ledNr]--;
-				if(ledsB[ledNr]>100)
-					ledsB[ledNr] = ledsB[ledNr] - ledsB[ledNr]/100;
-				else if(ledsB[ledNr]>0)
-					ledsB[ledNr]--;
-			}
-			break;
-		case MODE_TREASURE_INTRO:
-			/* In this mode, every silent note gets a red background based on the
-			 * expression pedal position. The background is only enabled when any note
-			 * is played, so first check if any note is played. */
-			any_on = false;
-			for(note = 0; note < 88; note++)
-			{
-				if(notes[note] > 0)
-				{
-					any_on = true;
-					break;
-				}
-			}
-			if(any_on)
-			{
-				/* Take expression as red intensity */
-				r = midiExpression;
-			}
-			else
-			{
-				/* No background */
-				r = 0;
-			}
-			g = 0;
-			b = 0;
-			for(note = 0; note < 88; note++)
-			{
-				if(notes[note] == 0)
-				{
-					/* This note is currently silent. Set it to the background color. */
-					ledSingleColorSetLed(r, g, b, ledMapping[note]);
-				}
-			}
-			break;
-		default:
-			break;
+		if (!ledEventPending)
+		{
+			ledEventTimestamp = received;
+			ledEventPending = true;
+		}
 	}
 }
+
 /**
-* This method is used for rendering a single LED according to a noteOn MIDI message being handled. Designed for being called from the MIDI handling routine.
-* @param inputNote The note for which the corresponding LED needs to be set.
-* @param mode Global LED effect mode.
-* @author Daniël Schenk
-* @date 2012-01-03
+* This method returns the input event latency statistics, in timestamp units (see @ref TIMESTAMP_TO_US).
+* @param latency Output for the statistics.
 */
-void ledRenderFromNoteOn(unsigned char inputNote, unsigned int mode)
+void ledGetLatency(Statistics_t *latency)
 {
-	if (mode == MODE_PETER_GUNN)
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		// first note should turn on background
-		setBackgroundColor(0, 0, 50);
+		*latency = ledLatency;
 	}
+}
 
-	//Turning LED on happens in the same way for some modes
-	if((mode >= MODE_START_NO_SUSTAIN && mode < MODE_END_SUSTAIN) || mode == MODE_TREASURE_INTRO)
+/**
+* This method clears the input event latency statistics.
+*/
+void ledResetLatency(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		mode = MODE_START_NO_SUSTAIN;
+		Statistics_Reset(&ledLatency);
 	}
-	switch(mode)
-	{
-		static uint8_t mode51 = 0;
-		case MODE_START_NO_SUSTAIN:
-			ledSingleColorUpdateLedOn(rMax,gMax,bMax,inputNote);
-			break;
-		case MODE_COPYRIGHT: //Red and blue, determined by note number odd/even
-			if ((inputNote % 2) == 0)
-			{
-				ledSingleColorUpdateLedOn(rMax,0,0,inputNote);
-			}
-			else
-			{
-				ledSingleColorUpdateLedOn(0,0,bMax,inputNote);
-			}
-			break;
-		case MODE_COPYRIGHT_V2: //Red and blue, alternated from note to note
-			if (ledsR[ledMapping[inputNote]] == 0 && ledsB[ledMapping[inputNote]] == 0)
-			{
-				if (mode51 == 0)
-				{
-					ledSingleColorUpdateLedOn(rMax,0,0,inputNote);
-					mode51 = 1;
-				}
-				else
-				{
-					ledSingleColorUpdateLedOn(0,0,bMax,inputNote);
-					mode51 = 0;
-				}
-			}
-			else if (ledsR[ledMapping[inputNote]] != 0)
-			{
-				ledSingleColorUpdateLedOn(rMax,0,0,inputNote);
-			}
-			else
-			{
-				ledSingleColorUpdateLedOn(0,0,bMax,inputNote);
-			}
+}
 
-			break;
-		case MODE_PETER_GUNN:
-			ledSingleColorUpdateLedOnMax(inputNote);
-			break;
-		case MODE_MULTICOLOR:
-			multicolorLedOn(inputNote);
-			break;
-		default:
-			break;
+/**
+* This method returns the statistics of the time needed to write a frame to the strip (excluding the pause period), in timestamp units (see @ref TIMESTAMP_TO_US).
+* @param frameTime Output for the statistics.
+*/
+void ledGetFrameTime(Statistics_t *frameTime)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*frameTime = ledFrameTime;
 	}
 }
+
 /**
-* This method is used for rendering a single LED according to a noteOff MIDI message being handled. Designed for being called from the MIDI handling routine.
-* @param inputNote The note for which the corresponding LED needs to be set.
-* @param mode Global LED effect mode.
+* This method returns the statistics of the time needed to render the after effects, in timestamp units (see @ref TIMESTAMP_TO_US and @ref TIMESTAMP_TO_CYCLES).
+* @param renderTime Output for the statistics.
+*/
+void ledGetRenderTime(Statistics_t *renderTime)
+{
+	*renderTime = ledRenderTime;
+}
+
+/**
+* This method ends the pause period required for the LED strip to apply received values. Writes the next frame if one has been rendered, otherwise the writer becomes idle until the next @ref ledFrameCommit.
 * @author Daniël Schenk
-* @date 2012-01-03
+* @date 2011-12-?
 */
-void ledRenderFromNoteOff(unsigned char inputNote, unsigned int mode)
+void ledEndPause(void)
 {
-	//Turning LED off happens in the same way for the first 7 modes and some more
-	if((mode >= MODE_START_NO_SUSTAIN && mode < MODE_END_NO_SUSTAIN) || mode == MODE_PETER_GUNN)
-	{
-		mode = MODE_START_NO_SUSTAIN;
-	}
-	if((mode >= MODE_START_SUSTAIN && mode < MODE_END_SUSTAIN)
-		|| mode == MODE_COPYRIGHT || mode == MODE_COPYRIGHT_V2 || mode == MODE_MULTICOLOR)
+	TCCR0B = (0<<CS02|0<<CS01|0<<CS00); //Stop timer
+	//TCNT0 = 0; //Reset timer value
+	//writeStripComplete = 0;
+
+	if (ledBackReady)
 	{
-		mode = MODE_START_SUSTAIN;
+		ledStartFrame();
 	}
-	switch(mode)
+	else
 	{
-		case MODE_START_NO_SUSTAIN:
-			ledSingleColorUpdateLedOff(inputNote);
-			break;
-		case MODE_START_SUSTAIN:
-			if(midiSustain == 0)
-				ledSingleColorUpdateLedOff(inputNote);
-			break;
-		default:
-			break;
+		ledWriteState = idle;
 	}
 }
 
-void ledRenderFromSustain(unsigned char mode, unsigned char sustain)
+/**
+* Calculate the PWM value of a level which is sent to the strip. The fraction of the PWM value is carried over to the next frame, so over a number of frames the average PWM value has 16-bit precision.
+*
+* @param level      The level
+* @param balance    White balance factor of the color, 255 is 100%
+* @param error      Fraction carried over from the previous frame
+* @return           The PWM value to send
+*/
+static inline uint8_t ledCalibrate(uint16_t level, uint8_t balance, uint8_t* error)
+{
+	uint16_t pwm = ((uint32_t)ledApplyGamma(level) * (balance + 1)) >> 8;
+	ledFractions |= (uint8_t)pwm;
+
+	pwm += *error; //Cannot overflow, the PWM value is at most 0xFF00
+	*error = (uint8_t)pwm;
+	return pwm >> 8;
+}
+
+/**
+* Estimate the sum of the PWM values of the frame to be composed at full power, from the levels of the lit LEDs.
+*
+* @return Sum of the PWM values, before dithering
+*/
+static uint32_t ledPwmDemand(void)
 {
-	if(mode >= MODE_START_NO_SUSTAIN && mode < MODE_END_NO_SUSTAIN) //Non-sustain modes
+	uint32_t sumR = 0;
+	uint32_t sumG = 0;
+	uint32_t sumB = 0;
+	for (uint8_t ledNr = 0; ledNr < ledCount; ledNr++)
 	{
-		mode = MODE_START_NO_SUSTAIN;
+		if (!(ledActive[ledNr >> 3] & (1 << (ledNr & 7))))
+			continue;
+		sumR += ledApplyGamma(ledR(ledNr));
+		sumG += ledApplyGamma(ledG(ledNr));
+		sumB += ledApplyGamma(ledB(ledNr));
 	}
-	if((mode >= MODE_START_SUSTAIN && mode < MODE_END_SUSTAIN)
-		|| mode == MODE_COPYRIGHT || mode == MODE_COPYRIGHT_V2 || mode == MODE_MULTICOLOR) //Sustain modes
+	return ((sumR >> 8) * (ledBalanceR + 1) + (sumG >> 8) * (ledBalanceG + 1) + (sumB >> 8) * (ledBalanceB + 1)) >> 8;
+}
+
+/**
+* Keep the current, estimated from the PWM values of the frame to be composed, within the power budget. When the frame would exceed the budget, the power scale drops right away so this frame fits, otherwise it slowly returns to the highest value which fits the budget.
+*
+* @param demand Sum of the PWM values of the frame at full power, see @ref ledPwmDemand
+*/
+static void ledLimitPower(uint32_t demand)
+{
+	//Scale which exactly meets the budget
+	uint16_t target = (demand <= ledPwmBudget) ? 256 : (ledPwmBudget << 8) / demand;
+	if (target < ledPowerScale)
 	{
-		mode = MODE_START_SUSTAIN;
+		ledPowerScale = target;
 	}
-	switch(mode)
+	else
 	{
-		case MODE_START_SUSTAIN: //Switch off LEDs at release of sustain pedal
-			if(sustain == 0)
-			{
-				for(int noteNr = 0; noteNr<88; noteNr++)
-				{
-					if(notes[noteNr]==0)
-						ledSingleColorSetLed(0,0,0,ledMapping[noteNr]);
-				}
-			}
-			break;
-		default:
-			break;
+		ledPowerScale += (target - ledPowerScale + 7) >> 3;
 	}
 }
 
-static void ledModeChange(unsigned int modeNr)
+/**
+* This method must be called when rendering is done, or when @ref ledDitherPending returns true. Converts the rendered levels into the back frame, applying the calibration of the strip (see ledcalibration.h) and temporal dithering, which will be shown after the frame currently being written. Must be called from the main loop.
+*/
+void ledFrameCommit(void)
 {
-	//Modes 8-14 have the same intensity settings as modes 1-7
-	if(modeNr >= MODE_START_SUSTAIN && modeNr < MODE_END_SUSTAIN)
+	//Nothing to show when nothing changed, unless dithering or power limiting still changes the output
+	if (ledDirty)
 	{
-		modeNr = modeNr - (MODE_END_SUSTAIN - MODE_START_SUSTAIN);
+		ledLevelsChangedTick = timerGetTickCount();
 	}
-	if (modeNr != MODE_PETER_GUNN)
+	else if (!ledDitherPending() && ledPowerScale >= 256)
 	{
-		setBackgroundColor(0, 0, 0);
+		return;
 	}
-	switch(modeNr)
+	ledDirty = false;
+
+	//Take the back frame out of reach of the LED write interrupts, so a half-composed frame is never shown
+	ledBackReady = false;
+
+	//The power scale is applied through the white balance factors, so it costs nothing per LED, and the dither fractions carried over match what is sent
+	ledLimitPower(ledPwmDemand());
+	uint8_t balanceR = ((uint16_t)ledBalanceR * ledPowerScale) >> 8;
+	uint8_t balanceG = ((uint16_t)ledBalanceG * ledPowerScale) >> 8;
+	uint8_t balanceB = ((uint16_t)ledBalanceB * ledPowerScale) >> 8;
+
+	uint8_t* data = ledBack->data;
+	const uint16_t* level = ledLevels;
+	uint8_t* error = ledDitherError;
+	ledFractions = 0;
+	for (uint8_t ledNr = 0; ledNr < ledCount; ledNr++)
 	{
-		case MODE_RED:
-			rMax = ledMaxInt;
-			gMax = 0;
-			bMax = 0;
-			break;
-		case MODE_GREEN:
-			rMax = 0;
-			gMax = ledMaxInt;
-			bMax = 0;
-			break;
-		case MODE_BLUE:
-			rMax = 0;
-			gMax = 0;
-			bMax = ledMaxInt;
-			break;
-		case MODE_YELLOW:
-			rMax = ledMaxInt;
-			gMax = ledMaxInt;
-			bMax = 0;
-			break;
-		case MODE_CYAN:
-			rMax = 0;
-			gMax = ledMaxInt;
-			bMax = ledMaxInt;
-			break;
-		case MODE_MAGENTA:
-			rMax = ledMaxInt;
-			gMax = 0;
-			bMax = ledMaxInt;
-			break;
-		case MODE_WHITE:
-			rMax = ledMaxInt;
-			gMax = ledMaxInt;
-			bMax = ledMaxInt;
-			break;
-		case MODE_COPYRIGHT:
-			rMax = ledMaxInt;
-			gMax = 0;
-			bMax = ledMaxInt;
-		case MODE_COPYRIGHT_V2:
-			rMax = ledMaxInt;
-			gMax = 0;
-			bMax = ledMaxInt;
-		case MODE_TREASURE_INTRO:
-			rMax = 0;
-			gMax = 0;
-			bMax = ledMaxInt;
-			break;
-		case MODE_PETER_GUNN:
-			rMax = ledMaxInt;
-			gMax = ledMaxInt;
-			bMax = ledMaxInt;
-			break;
-		default:
+		data[ledOffsetR] = ledCalibrate(level[ledOffsetR], balanceR, &error[ledOffsetR]);
+		data[ledOffsetG] = ledCalibrate(level[ledOffsetG], balanceG, &error[ledOffsetG]);
+		data[ledOffsetB] = ledCalibrate(level[ledOffsetB], balanceB, &error[ledOffsetB]);
+		data += ledBytesPerLed;
+		level += ledBytesPerLed;
+		error += ledBytesPerLed;
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ledBackReady = true;
+		if (ledWriteState == idle)
+		{
+			ledStartFrame();
+		}
+	}
+}
+
+/**
+* This method returns whether a new frame must be composed to continue temporal dithering, because the last composed frame has been taken by the LED writer and contained PWM values between two steps. Only levels which changed recently are dithered, static levels keep the last frame so the CPU can sleep. Must be called from the main loop.
+* @return True if @ref ledFrameCommit should be called, even if nothing was rendered.
+*/
+bool ledDitherPending(void)
+{
+	return ledFractions != 0 && !ledBackReady && (timerGetTickCount() - ledLevelsChangedTick) < ledDitherHoldTicks;
+}
+/**
+ * Decay the levels of an LED according to the release of the current mode
+ *
+ * @param level     Pointer to the levels of the LED
+ * @return          Nonzero if the LED is still lit
+ */
+static inline uint16_t ledDecay(uint16_t* level)
+{
+	//Exponential decay with one multiplication per level, no divisions. The fraction bits keep long tails smooth.
+	level[0] = ((uint32_t)level[0] * ledReleaseFactor) >> 16;
+	level[1] = ((uint32_t)level[1] * ledReleaseFactor) >> 16;
+	level[2] = ((uint32_t)level[2] * ledReleaseFactor) >> 16;
+	return level[0] | level[1] | level[2];
+}
+
+/**
+ * Look up a color in the gradient of the current mode
+ *
+ * @param index     The gradient index
+ * @param color     Output for the color
+ */
+static inline void ledGradientColor(uint8_t index, Color* color)
+{
+	memcpy_P(color, &ledGradients[ledEffect.gradient][index], sizeof(*color));
+}
+
+/**
+ * Turn on the LED of a note in a color of the gradient of the current mode, scaled by velocity
+ *
+ * @param noteNr    The note number
+ * @param index     The gradient index
+ */
+static void ledGradientLedOn(uint8_t noteNr, uint8_t index)
+{
+	uint8_t velocity = notes[noteNr];
+	uint8_t ledNumber = ledMapping[noteNr];
+	Color color;
+	ledGradientColor(index, &color);
+	ledPartColor(noteNr, &color);
+
+	ledMarkActive(ledNumber);
+	ledR(ledNumber) = ledLevel(velocityToIntensity(velocity, color.r));
+	ledG(ledNumber) = ledLevel(velocityToIntensity(velocity, color.g));
+	ledB(ledNumber) = ledLevel(velocityToIntensity(velocity, color.b));
+}
+
+/**
+ * Gradient indexed by note position, spread across the keyboard
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectGradientPositionOn(uint8_t noteNr)
+{
+	ledGradientLedOn(noteNr, ((uint16_t)noteNr * 750) >> 8);
+}
+
+/**
+ * Gradient indexed by velocity
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectGradientVelocityOn(uint8_t noteNr)
+{
+	ledGradientLedOn(noteNr, notes[noteNr] * 2);
+}
+
+/**
+ * Gradient indexed by pitch class, so every C has the same color
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectGradientPitchClassOn(uint8_t noteNr)
+{
+	ledGradientLedOn(noteNr, midiPitchClass(noteNr) * 21);
+}
+
+/**
+ * Gradient indexed by time, cycling through the gradient in about 5 seconds
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectGradientTimeOn(uint8_t noteNr)
+{
+	ledGradientLedOn(noteNr, timerGetTickCount() >> 1);
+}
+
+/**
+ * Gradient in sequence, every note gets the next color of the palette
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectGradientSequenceOn(uint8_t noteNr)
+{
+	ledGradientLedOn(noteNr, ledSequenceIndex >> 8);
+
+	uint16_t next = ledSequenceIndex + ledSequenceStep;
+	//Start at the center of the first band again after a pass, so rounding of the step does not add up
+	ledSequenceIndex = (next < ledSequenceIndex) ? ledSequenceStep / 2 : next;
+}
+
+static void ledEffectIgnoreNote(uint8_t noteNr)
+{
+}
+
+static void ledEffectIgnorePedal(uint8_t sustain)
+{
+}
+
+static void ledEffectIgnoreFrame(void)
+{
+}
+
+static bool ledEffectNeverAnimating(void)
+{
+	return false;
+}
+
+static bool ledEffectAlwaysAnimating(void)
+{
+	return true;
+}
+
+/**
+ * Turn on the LED of a note in the maximum intensity of the mode, scaled by velocity
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectSingleColorOn(uint8_t noteNr)
+{
+	ledSingleColorUpdateLedOn(ledEffect.max.r, ledEffect.max.g, ledEffect.max.b, noteNr);
+}
+
+/**
+ * Turn off the LED of a note, unless the sustain pedal is pressed
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectSustainedLedOff(uint8_t noteNr)
+{
+	if(midiSustain == 0)
+		ledSingleColorUpdateLedOff(noteNr);
+}
+
+/**
+ * Switch off the LEDs of silent notes at release of the sustain pedal
+ *
+ * @param sustain   The sustain pedal value
+ */
+static void ledEffectSustainPedal(uint8_t sustain)
+{
+	if(sustain == 0)
+	{
+		for(uint8_t noteNr = 0; noteNr < 88; noteNr++)
+		{
+			uint8_t ledNr = ledMapping[noteNr];
+			uint8_t bit = 1 << (ledNr & 7);
+			//Only the lit LEDs of released notes were held by the pedal
+			if(notes[noteNr] == 0 && (ledActive[ledNr >> 3] & bit))
+			{
+				ledR(ledNr) = 0;
+				ledG(ledNr) = 0;
+				ledB(ledNr) = 0;
+				ledActive[ledNr >> 3] &= ~bit;
+				ledDirty = true;
+			}
+		}
+	}
+}
+
+/**
+ * Decay all lit LEDs according to the release of the mode
+ */
+static void ledEffectDecay(void)
+{
+	//Only lit LEDs decay, 8 LEDs at once are skipped when none of them is lit
+	for (uint8_t byteNr = 0; byteNr < sizeof(ledActive); byteNr++)
+	{
+		uint8_t active = ledActive[byteNr];
+		if (active == 0)
+			continue;
+
+		uint8_t ledNr = byteNr * 8;
+		for (uint8_t bit = 1; bit != 0; bit <<= 1, ledNr++)
+		{
+			if ((active & bit) && ledDecay(&ledLevels[ledNr * ledBytesPerLed]) == 0)
+			{
+				active &= ~bit;
+			}
+		}
+		ledActive[byteNr] = active;
+		ledDirty = true;
+	}
+}
+
+/**
+ * Check whether any LED is lit, so there is something to decay
+ *
+ * @return          True when an LED is lit
+ */
+static bool ledEffectDecayAnimating(void)
+{
+	for (uint8_t byteNr = 0; byteNr < sizeof(ledActive); byteNr++)
+	{
+		if (ledActive[byteNr] != 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Two colors of the palette, determined by note number odd/even
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectCopyrightOn(uint8_t noteNr)
+{
+	Color color;
+	ledGradientColor((noteNr & 1) << 7, &color);
+	ledSingleColorUpdateLedOn(color.r, color.g, color.b, noteNr);
+}
+
+/**
+ * Red and blue, alternated from note to note. A note which is still lit keeps its color.
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectCopyrightV2On(uint8_t noteNr)
+{
+	static uint8_t mode51 = 0;
+	uint8_t ledNumber = ledMapping[noteNr];
+	//The second part shows red in blue and blue in green, see ledPartColor
+	uint8_t red = ledIntensity(ledIsPartB(noteNr) ? ledB(ledNumber) : ledR(ledNumber));
+	uint8_t blue = ledIntensity(ledIsPartB(noteNr) ? ledG(ledNumber) : ledB(ledNumber));
+	if (red == 0 && blue == 0)
+	{
+		if (mode51 == 0)
+		{
+			ledSingleColorUpdateLedOn(ledEffect.max.r,0,0,noteNr);
+			mode51 = 1;
+		}
+		else
+		{
+			ledSingleColorUpdateLedOn(0,0,ledEffect.max.b,noteNr);
+			mode51 = 0;
+		}
+	}
+	else if (red != 0)
+	{
+		ledSingleColorUpdateLedOn(ledEffect.max.r,0,0,noteNr);
+	}
+	else
+	{
+		ledSingleColorUpdateLedOn(0,0,ledEffect.max.b,noteNr);
+	}
+}
+
+/**
+ * Give a released note the current background
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectTreasureIntroOff(uint8_t noteNr)
+{
+	if(ledTreasureBackground >= 0)
+		ledSingleColorSetLed(ledTreasureBackground, 0, 0, ledMapping[noteNr]);
+}
+
+/**
+ * Every silent note gets a red background based on the expression pedal position. The background is only enabled when any note is played.
+ */
+static void ledEffectTreasureIntroFrame(void)
+{
+	uint8_t r;
+	if(midiNotesOn > 0)
+	{
+		/* Take expression as red intensity */
+		r = midiExpression;
+	}
+	else
+	{
+		/* No background */
+		r = 0;
+	}
+	/* Notes which become silent get the background when they are released,
+	 * so only a changed background needs to be applied to all of them. */
+	if(r == ledTreasureBackground)
+		return;
+	ledTreasureBackground = r;
+	for(uint8_t note = 0; note < 88; note++)
+	{
+		if(notes[note] == 0)
+		{
+			/* This note is currently silent. Set it to the background color. */
+			ledSingleColorSetLed(r, 0, 0, ledMapping[note]);
+		}
+	}
+}
+
+/**
+ * The first note turns on the background
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectPeterGunnOn(uint8_t noteNr)
+{
+	setBackgroundColor(0, 0, 50);
+	ledSingleColorUpdateLedOnMax(noteNr);
+}
+
+static void ledEffectColorCycleTestFrame(void)
+{
+	ledSingleColorSetFull(ledTestColor->r, ledTestColor->g, ledTestColor->b);
+}
+
+/** Stages of the envelope of a note */
+typedef enum
+{
+	ledStageOff,
+	ledStageAttack,
+	ledStageDecay,
+	ledStageSustain,
+	ledStageRelease,
+} LedEnvelopeStage;
+
+//Envelope state of all notes, as separate arrays so the update loop stays tight
+static uint8_t ledEnvelopeStages[88]; //!<LedEnvelopeStage of each note
+static uint16_t ledEnvelopeLevels[88]; //!<Envelope level of each note, in 0.16 fixed point
+static uint8_t ledEnvelopePeaks[88]; //!<Intensity of each note at full envelope level, from the velocity
+static uint8_t ledEnvelopesActive = 0; //!<Number of notes of which the envelope is not off
+
+/**
+ * Write the LED of a note according to its envelope level
+ *
+ * @param noteNr    The note number
+ */
+static void ledEnvelopeApply(uint8_t noteNr)
+{
+	uint8_t ledNumber = ledMapping[noteNr];
+	uint32_t level = ((uint32_t)ledEnvelopePeaks[noteNr] * ledEnvelopeLevels[noteNr]) >> 8;
+	Color color = ledEffect.max;
+	ledPartColor(noteNr, &color);
+
+	ledMarkActive(ledNumber);
+	ledR(ledNumber) = (level * (color.r + 1)) >> 8;
+	ledG(ledNumber) = (level * (color.g + 1)) >> 8;
+	ledB(ledNumber) = (level * (color.b + 1)) >> 8;
+}
+
+/**
+ * Release the envelope of a note
+ *
+ * @param noteNr    The note number
+ */
+static void ledEnvelopeRelease(uint8_t noteNr)
+{
+	if (ledEnvelopeStages[noteNr] != ledStageOff)
+	{
+		ledEnvelopeStages[noteNr] = ledStageRelease;
+	}
+}
+
+/**
+ * Start the attack of the envelope of a note, from its current level so a note which is played again does not flash
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectEnvelopeOn(uint8_t noteNr)
+{
+	if (ledEnvelopeStages[noteNr] == ledStageOff)
+	{
+		ledEnvelopesActive++;
+	}
+	ledEnvelopeStages[noteNr] = ledStageAttack;
+	ledEnvelopePeaks[noteNr] = velocityToIntensity(notes[noteNr], MAX_INTENSITY);
+
+	//First step right away, so an instant attack shows without waiting for the next frame
+	uint16_t level = ledEnvelopeLevels[noteNr];
+	if (level >= UINT16_MAX - ledEnvelope.attackStep)
+	{
+		level = UINT16_MAX;
+		ledEnvelopeStages[noteNr] = ledStageDecay;
+	}
+	else
+	{
+		level += ledEnvelope.attackStep;
+	}
+	ledEnvelopeLevels[noteNr] = level;
+	ledEnvelopeApply(noteNr);
+}
+
+/**
+ * Release the envelope of a note, unless the sustain pedal is pressed
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectEnvelopeOff(uint8_t noteNr)
+{
+	if(midiSustain == 0)
+		ledEnvelopeRelease(noteNr);
+}
+
+/**
+ * Release the envelopes of silent notes at release of the sustain pedal
+ *
+ * @param sustain   The sustain pedal value
+ */
+static void ledEffectEnvelopePedal(uint8_t sustain)
+{
+	if(sustain == 0)
+	{
+		for(uint8_t noteNr = 0; noteNr < 88; noteNr++)
+		{
+			if(notes[noteNr] == 0)
+				ledEnvelopeRelease(noteNr);
+		}
+	}
+}
+
+/**
+ * Advance the envelopes of all notes which are not off or sustained
+ */
+static void ledEffectEnvelopeFrame(void)
+{
+	if (ledEnvelopesActive == 0)
+		return;
+
+	for (uint8_t noteNr = 0; noteNr < 88; noteNr++)
+	{
+		uint16_t level = ledEnvelopeLevels[noteNr];
+		switch (ledEnvelopeStages[noteNr])
+		{
+			case ledStageAttack:
+				if (level >= UINT16_MAX - ledEnvelope.attackStep)
+				{
+					level = UINT16_MAX;
+					ledEnvelopeStages[noteNr] = ledStageDecay;
+				}
+				else
+				{
+					level += ledEnvelope.attackStep;
+				}
+				break;
+			case ledStageDecay:
+				if (level <= ledEnvelope.sustainLevel)
+				{
+					level = ledEnvelope.sustainLevel;
+					ledEnvelopeStages[noteNr] = ledStageSustain;
+				}
+				else
+				{
+					level = ledEnvelope.sustainLevel + (((uint32_t)(level - ledEnvelope.sustainLevel) * ledEnvelope.decayFactor) >> 16);
+				}
+				break;
+			case ledStageRelease:
+				level = ((uint32_t)level * ledReleaseFactor) >> 16;
+				if (level == 0)
+				{
+					ledEnvelopeStages[noteNr] = ledStageOff;
+					ledEnvelopesActive--;
+				}
+				break;
+			default:
+				//Off or sustained, nothing changes
+				continue;
+		}
+		ledEnvelopeLevels[noteNr] = level;
+		ledEnvelopeApply(noteNr);
+	}
+}
+
+/**
+ * Check whether the envelope of any note is not off
+ *
+ * @return          True when an envelope is active
+ */
+static bool ledEffectEnvelopeAnimating(void)
+{
+	return ledEnvelopesActive != 0;
+}
+
+/**
+ * Stop all envelopes, without changing the LEDs
+ */
+static void ledEnvelopeReset(void)
+{
+	memset(ledEnvelopeStages, ledStageOff, sizeof(ledEnvelopeStages));
+	memset(ledEnvelopeLevels, 0, sizeof(ledEnvelopeLevels));
+	ledEnvelopesActive = 0;
+}
+
+#define ledRippleCount 8 //!<Maximum number of ripples at the same time, which bounds the work per frame
+#define ledRippleFade 200 //!<Factor by which the intensity of a ripple fades per frame, 256 is 100%
+#define ledRippleMinIntensity 8 //!<Ripples which are fainter than this are removed
+
+/** Light which spreads from a played note to both sides, one note per frame */
+typedef struct
+{
+	uint8_t note; //!<Note which started the ripple
+	uint8_t radius; //!<Distance in notes from the start note
+	uint8_t intensity; //!<Current intensity, 0 if the ripple is not in use
+} LedRipple;
+
+static LedRipple ledRipples[ledRippleCount];
+static uint8_t ledRippleNext = 0; //!<Ripple which is reused for the next note, the oldest one when all are in use
+
+/**
+ * Light the LED of a note in the color of the mode at the given intensity, unless it is brighter already
+ *
+ * @param noteNr    The note number
+ * @param intensity The intensity, 255 is the full color of the mode
+ */
+static void ledRippleLight(uint8_t noteNr, uint8_t intensity)
+{
+	uint8_t ledNumber = ledMapping[noteNr];
+	uint16_t factor = intensity + 1;
+	ledMarkActive(ledNumber);
+	applyNewIntensityIfHigher(&ledR(ledNumber), (ledEffect.max.r * factor) >> 8);
+	applyNewIntensityIfHigher(&ledG(ledNumber), (ledEffect.max.g * factor) >> 8);
+	applyNewIntensityIfHigher(&ledB(ledNumber), (ledEffect.max.b * factor) >> 8);
+}
+
+/**
+ * Light the note and start a ripple from it
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectRippleOn(uint8_t noteNr)
+{
+	ledEffectSingleColorOn(noteNr);
+
+	LedRipple* ripple = &ledRipples[ledRippleNext];
+	ripple->note = noteNr;
+	ripple->radius = 0;
+	ripple->intensity = velocityToIntensity(notes[noteNr], MAX_INTENSITY);
+	if (++ledRippleNext >= ledRippleCount)
+		ledRippleNext = 0;
+}
+
+/**
+ * Decay all lit LEDs, and move all ripples one note further. The decay of the notes they passed draws their tails.
+ */
+static void ledEffectRippleFrame(void)
+{
+	ledEffectDecay();
+
+	for (uint8_t i = 0; i < ledRippleCount; i++)
+	{
+		LedRipple* ripple = &ledRipples[i];
+		if (ripple->intensity == 0)
+			continue;
+
+		ripple->radius++;
+		ripple->intensity = (ripple->intensity * ledRippleFade) >> 8;
+
+		bool visible = false;
+		if (ripple->radius <= ripple->note)
+		{
+			ledRippleLight(ripple->note - ripple->radius, ripple->intensity);
+			visible = true;
+		}
+		if (ripple->note + ripple->radius < 88)
+		{
+			ledRippleLight(ripple->note + ripple->radius, ripple->intensity);
+			visible = true;
+		}
+		if (!visible || ripple->intensity < ledRippleMinIntensity)
+		{
+			ripple->intensity = 0;
+		}
+	}
+}
+
+/**
+ * Check whether a ripple is moving, or an LED is lit which decays
+ *
+ * @return          True when a ripple moves or an LED is lit
+ */
+static bool ledEffectRippleAnimating(void)
+{
+	for (uint8_t i = 0; i < ledRippleCount; i++)
+	{
+		if (ledRipples[i].intensity != 0)
+			return true;
+	}
+	return ledEffectDecayAnimating();
+}
+
+static uint8_t ledChordRoot = midiNoNote; //!<Chord root the lit notes are colored for
+
+/**
+ * Gradient index of a note by its interval above the chord root
+ *
+ * @param noteNr    The note number
+ * @return          The gradient index
+ */
+static uint8_t ledChordIndex(uint8_t noteNr)
+{
+	uint8_t interval = midiPitchClass(noteNr) + 12 - ledChordRoot;
+	if (interval >= 12)
+		interval -= 12;
+	return interval * 21;
+}
+
+/**
+ * Follow the chord root. When it changes, the lit LEDs are colored again at their current level, otherwise nothing needs to be done.
+ */
+static void ledChordUpdate(void)
+{
+	uint8_t root = midiChordRoot();
+	if (root == ledChordRoot || root == midiNoNote)
+		return;
+	ledChordRoot = root;
+
+	//Only lit LEDs change, 8 LEDs at once are skipped when none of them is lit
+	for (uint8_t byteNr = 0; byteNr < sizeof(ledActive); byteNr++)
+	{
+		uint8_t active = ledActive[byteNr];
+		if (active == 0)
+			continue;
+
+		uint8_t ledNr = byteNr * 8;
+		for (uint8_t bit = 1; bit != 0; bit <<= 1, ledNr++)
+		{
+			if (!(active & bit))
+				continue;
+			uint8_t noteNr = ledNoteOfLed(ledNr);
+			if (noteNr == ledNoNote)
+				continue;
+
+			//Keep the level of the decay, and only change the color
+			uint32_t level = ledR(ledNr);
+			if (ledG(ledNr) > level)
+				level = ledG(ledNr);
+			if (ledB(ledNr) > level)
+				level = ledB(ledNr);
+			Color color;
+			ledGradientColor(ledChordIndex(noteNr), &color);
+			ledPartColor(noteNr, &color);
+			ledR(ledNr) = (level * (color.r + 1)) >> 8;
+			ledG(ledNr) = (level * (color.g + 1)) >> 8;
+			ledB(ledNr) = (level * (color.b + 1)) >> 8;
+		}
+	}
+	ledDirty = true;
+}
+
+/**
+ * Color the note by its interval above the chord root, which makes the root of every chord the same color
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectChordOn(uint8_t noteNr)
+{
+	ledChordUpdate();
+	ledGradientLedOn(noteNr, ledChordIndex(noteNr));
+}
+
+/**
+ * Turn off the LED of a note like sustain modes, and follow the chord root
+ *
+ * @param noteNr    The note number
+ */
+static void ledEffectChordOff(uint8_t noteNr)
+{
+	ledEffectSustainedLedOff(noteNr);
+	ledChordUpdate();
+}
+
+/** Single color mode, the LED of a note turns off when the note is released */
+#define ledEffectNoSustain(modeNr, r, g, b) \
+	{modeNr, {r, g, b}, ledRelease8s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow, ledEffectSingleColorOn, ledSingleColorUpdateLedOff, ledEffectIgnorePedal, ledEffectIgnoreFrame, ledEffectNeverAnimating}
+
+/** Single color mode, the LED of a note decays while the note or the sustain pedal is held */
+#define ledEffectSustain(modeNr, r, g, b) \
+	{modeNr, {r, g, b}, ledRelease8s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow, ledEffectSingleColorOn, ledEffectSustainedLedOff, ledEffectSustainPedal, ledEffectDecay, ledEffectDecayAnimating}
+
+/** Single color mode, the LED of a note follows an envelope */
+#define ledEffectEnvelope(modeNr, r, g, b, release, envelope) \
+	{modeNr, {r, g, b}, release, ledCurveLinear, envelope, ledGradientRainbow, ledEffectEnvelopeOn, ledEffectEnvelopeOff, ledEffectEnvelopePedal, ledEffectEnvelopeFrame, ledEffectEnvelopeAnimating}
+
+/** Mode in which the LED of a note takes a color from a gradient, and decays while the note or the sustain pedal is held */
+#define ledEffectGradient(modeNr, onNoteOn, gradient) \
+	{modeNr, {ledMaxInt, ledMaxInt, ledMaxInt}, ledRelease4s, ledCurveLinear, ledEnvelopeNone, gradient, onNoteOn, ledEffectSustainedLedOff, ledEffectSustainPedal, ledEffectDecay, ledEffectDecayAnimating}
+
+/** Effects of all modes */
+static const LedEffect ledEffects[] PROGMEM = {
+	ledEffectNoSustain(MODE_RED, ledMaxInt, 0, 0),
+	ledEffectNoSustain(MODE_GREEN, 0, ledMaxInt, 0),
+	ledEffectNoSustain(MODE_BLUE, 0, 0, ledMaxInt),
+	ledEffectNoSustain(MODE_YELLOW, ledMaxInt, ledMaxInt, 0),
+	ledEffectNoSustain(MODE_CYAN, 0, ledMaxInt, ledMaxInt),
+	ledEffectNoSustain(MODE_MAGENTA, ledMaxInt, 0, ledMaxInt),
+	ledEffectNoSustain(MODE_WHITE, ledMaxInt, ledMaxInt, ledMaxInt),
+	ledEffectSustain(MODE_RED_SUSTAIN, ledMaxInt, 0, 0),
+	ledEffectSustain(MODE_GREEN_SUSTAIN, 0, ledMaxInt, 0),
+	ledEffectSustain(MODE_BLUE_SUSTAIN, 0, 0, ledMaxInt),
+	ledEffectSustain(MODE_YELLOW_SUSTAIN, ledMaxInt, ledMaxInt, 0),
+	ledEffectSustain(MODE_CYAN_SUSTAIN, 0, ledMaxInt, ledMaxInt),
+	ledEffectSustain(MODE_MAGENTA_SUSTAIN, ledMaxInt, 0, ledMaxInt),
+	ledEffectSustain(MODE_WHITE_SUSTAIN, ledMaxInt, ledMaxInt, ledMaxInt),
+	ledEffectEnvelope(MODE_WHITE_PAD, ledMaxInt, ledMaxInt, ledMaxInt, ledRelease4s, ledEnvelopePad),
+	ledEffectEnvelope(MODE_WHITE_PIANO, ledMaxInt, ledMaxInt, ledMaxInt, ledRelease1s, ledEnvelopePiano),
+	{MODE_COPYRIGHT, {ledMaxInt, 0, ledMaxInt}, ledRelease8s, ledCurveLinear, ledEnvelopeNone, ledGradientRedBlue,
+		ledEffectCopyrightOn, ledEffectSustainedLedOff, ledEffectSustainPedal, ledEffectIgnoreFrame, ledEffectNeverAnimating},
+	{MODE_COPYRIGHT_V2, {ledMaxInt, 0, ledMaxInt}, ledRelease8s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow,
+		ledEffectCopyrightV2On, ledEffectSustainedLedOff, ledEffectSustainPedal, ledEffectIgnoreFrame, ledEffectNeverAnimating},
+	{MODE_TREASURE_INTRO, {0, 0, ledMaxInt}, ledRelease8s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow,
+		ledEffectSingleColorOn, ledEffectTreasureIntroOff, ledEffectIgnorePedal, ledEffectTreasureIntroFrame, ledEffectAlwaysAnimating},
+	{MODE_PETER_GUNN, {ledMaxInt, ledMaxInt, ledMaxInt}, ledRelease8s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow,
+		ledEffectPeterGunnOn, ledSingleColorUpdateLedOff, ledEffectIgnorePedal, ledEffectIgnoreFrame, ledEffectNeverAnimating},
+	//Multicolor changes color on every note. Soft notes are made brighter, and a shorter release keeps the colors apart.
+	{MODE_MULTICOLOR, {ledMaxInt, ledMaxInt, ledMaxInt}, ledRelease4s, ledCurveLog, ledEnvelopeNone, ledGradientMulticolor,
+		ledEffectGradientSequenceOn, ledEffectSustainedLedOff, ledEffectSustainPedal, ledEffectDecay, ledEffectDecayAnimating},
+	{MODE_FULL_STRIP_COLOR_CYCLE_TEST, {ledMaxInt, ledMaxInt, ledMaxInt}, ledRelease8s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow,
+		ledEffectIgnoreNote, ledEffectIgnoreNote, ledEffectIgnorePedal, ledEffectColorCycleTestFrame, ledEffectAlwaysAnimating},
+	ledEffectGradient(MODE_RAINBOW, ledEffectGradientPositionOn, ledGradientRainbow),
+	ledEffectGradient(MODE_VELOCITY_FIRE, ledEffectGradientVelocityOn, ledGradientFire),
+	ledEffectGradient(MODE_PITCH_CLASS, ledEffectGradientPitchClassOn, ledGradientRainbow),
+	ledEffectGradient(MODE_RAINBOW_TIME, ledEffectGradientTimeOn, ledGradientRainbow),
+	{MODE_RIPPLE, {0, ledMaxInt, ledMaxInt}, ledRelease1s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow,
+		ledEffectRippleOn, ledEffectSustainedLedOff, ledEffectSustainPedal, ledEffectRippleFrame, ledEffectRippleAnimating},
+	{MODE_CHORD, {ledMaxInt, ledMaxInt, ledMaxInt}, ledRelease2s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow,
+		ledEffectChordOn, ledEffectChordOff, ledEffectSustainPedal, ledEffectDecay, ledEffectDecayAnimating},
+};
+
+/** Effect of modes which are not in ledEffects */
+static const LedEffect ledEffectNone PROGMEM =
+	{0, {0, 0, 0}, ledRelease8s, ledCurveLinear, ledEnvelopeNone, ledGradientRainbow, ledEffectIgnoreNote, ledEffectIgnoreNote, ledEffectIgnorePedal, ledEffectIgnoreFrame, ledEffectNeverAnimating};
+
+/**
+* This method is used for rendering LED effects after turning on (e.g. dimming slowly to zero). Designed for running at a fixed interval.
+* @author Daniël Schenk
+* @date 2011-12-?
+*/
+void ledRenderAfterEffects(void)
+{
+	Timestamp_t start = timerGetTimestamp();
+
+	ledEffect.onFrame();
+
+	Statistics_Add(&ledRenderTime, timerGetTimestamp() - start);
+}
+
+/**
+* This method returns whether @ref ledRenderAfterEffects would change anything. When it returns false, rendering can be skipped until the next MIDI event.
+*/
+bool ledAnimating(void)
+{
+	return ledEffect.isAnimating();
+}
+/**
+* This method is used for rendering a single LED according to a noteOn MIDI message being handled. Designed for being called from the MIDI handling routine.
+* @param inputNote The note for which the corresponding LED needs to be set.
+* @param part Part which plays the note. The second part (1) gets the colors of the effect rotated.
+* @author Daniël Schenk
+* @date 2012-01-03
+*/
+void ledRenderFromNoteOn(unsigned char inputNote, uint8_t part)
+{
+	//The effects rotate the colors of the note by its part, see ledPartColor
+	uint8_t bit = 1 << (inputNote & 7);
+	if (part != 0)
+		ledNotePartB[inputNote >> 3] |= bit;
+	else
+		ledNotePartB[inputNote >> 3] &= ~bit;
+
+	ledEffect.onNoteOn(inputNote);
+}
+/**
+* This method is used for rendering a single LED according to a noteOff MIDI message being handled. Designed for being called from the MIDI handling routine.
+* @param inputNote The note for which the corresponding LED needs to be set.
+* @author Daniël Schenk
+* @date 2012-01-03
+*/
+void ledRenderFromNoteOff(unsigned char inputNote)
+{
+	ledEffect.onNoteOff(inputNote);
+}
+
+void ledRenderFromSustain(unsigned char sustain)
+{
+	ledEffect.onPedal(sustain);
+}
+
+static void ledModeChange(unsigned int modeNr)
+{
+	const LedEffect* effect = &ledEffectNone;
+	for (uint8_t i = 0; i < NUM_ELEMENTS(ledEffects); i++)
+	{
+		if (pgm_read_byte(&ledEffects[i].mode) == modeNr)
+		{
+			effect = &ledEffects[i];
 			break;
+		}
+	}
+	memcpy_P(&ledEffect, effect, sizeof(ledEffect));
+	ledReleaseFactor = pgm_read_word(&ledReleaseFactors[ledEffect.release]);
+	memcpy_P(&ledEnvelope, &ledEnvelopes[ledEffect.envelope], sizeof(ledEnvelope));
+	uint8_t bands = pgm_read_byte(&ledGradientBands[ledEffect.gradient]);
+	ledSequenceStep = (bands != 0) ? (0x10000UL + bands - 1) / bands : 0x1000; //Continuous gradients in 16 steps
+	ledSequenceIndex = ledSequenceStep / 2;
+	ledEnvelopeReset();
+	memset(ledRipples, 0, sizeof(ledRipples));
+	ledChordRoot = midiNoNote;
+	ledTreasureBackground = -1;
+
+	if (modeNr != MODE_PETER_GUNN)
+	{
+		setBackgroundColor(0, 0, 0);
 	}
 }
 
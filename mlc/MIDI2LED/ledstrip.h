@@ -11,33 +11,67 @@
 #ifndef LEDSTRIP_H_
 #define LEDSTRIP_H_
 
-#define ledsProgrammed 88
 #define ledBaud 2000000 //!< Ledstrip data rate
 #define setpoint_high 255 //!< For debugging purposes
 #define ledMaxInt 255 //!< Global maximum intensity
 
 #include <inttypes.h>
+#include <stdbool.h>
+#include "timer.h"
+#include "Common/Statistics.h"
+
+#define ledBytesPerLed 3
+
+//Supported orders in which the strip expects the colors of an LED
+#define ledWireOrderRGB 0
+#define ledWireOrderGRB 1
+#define ledWireOrderBRG 2
+
+#ifndef ledWireOrder
+#define ledWireOrder ledWireOrderRGB //!< Color order of the connected strip
+#endif
+
+#if ledWireOrder == ledWireOrderRGB
+#define ledOffsetR 0
+#define ledOffsetG 1
+#define ledOffsetB 2
+#elif ledWireOrder == ledWireOrderGRB
+#define ledOffsetR 1
+#define ledOffsetG 0
+#define ledOffsetB 2
+#elif ledWireOrder == ledWireOrderBRG
+#define ledOffsetR 1
+#define ledOffsetG 2
+#define ledOffsetB 0
+#else
+#error "Unsupported ledWireOrder"
+#endif
 
 enum ledWriteStateEnum
 {
-	writeR,
-	writeG,
-	writeB,
+	writeFrame,
 	pause,
-	render
+	idle
 };
 
 void ledInit();
 void ledSingleColorUpdateFull(uint8_t r, uint8_t g, uint8_t b);
 void ledSingleColorUpdateLedOn(uint8_t r, uint8_t g, uint8_t b, uint8_t noteNr);
-void ledWriteNextByte();
 void ledEndPause(void);
-void ledRenderAfterEffects(unsigned int mode);
-void ledRenderFromNoteOn(unsigned char inputNote, unsigned int mode);
-void ledRenderFromNoteOff(unsigned char inputNote, unsigned int mode);
+void ledFrameCommit(void);
+bool ledDitherPending(void);
+void ledRenderAfterEffects(void);
+bool ledAnimating(void);
+void ledRenderFromNoteOn(unsigned char inputNote, uint8_t part);
+void ledRenderFromNoteOff(unsigned char inputNote);
 void ledSingleColorSetLed(uint8_t r, uint8_t g, uint8_t b, uint8_t ledNr);
 void ledSingleColorSetFull(int16_t r, int16_t g, int16_t b);
-void ledRenderFromSustain(unsigned char mode, unsigned char sustain);
+void ledRenderFromSustain(unsigned char sustain);
 void ledSingleColorUpdateLedOff(uint8_t noteNr);
+void ledEventRendered(Timestamp_t received);
+void ledGetLatency(Statistics_t *latency);
+void ledResetLatency(void);
+void ledGetFrameTime(Statistics_t *frameTime);
+void ledGetRenderTime(Statistics_t *renderTime);
 
 #endif
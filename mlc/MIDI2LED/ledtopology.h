@@ -0,0 +1,56 @@
+/**
+* @file ledtopology.h
+* @brief LED strip topology definitions
+*
+* The topology describes how the strip is routed along the keyboard, as a list of segments in the order they are connected.
+* Each segment is a row of consecutive LEDs which light consecutive notes with a fixed note step, so the direction of a
+* segment is given by the sign of the step. Notes which are not in any segment have no LED, and LEDs which are not
+* in any segment are not part of the frame, so they cost nothing on the wire. LEDs which must be clocked through without
+* lighting a note (e.g. around a corner) are described by a segment with first note ledNoNote.
+*
+* A topology is a macro which applies the given macro to each segment as segment(firstNote, noteStep, count), which
+* allows both computing the LED count at compile time and generating the segment table.
+*
+* @author Daniël Schenk
+*
+* @date 2026-10-16
+*/
+
+#ifndef LEDTOPOLOGY_H_
+#define LEDTOPOLOGY_H_
+
+#include <inttypes.h>
+
+#define ledNoNote 0xFF //!< First note of a segment of LEDs which don't light any note
+
+//Supported topologies
+#define ledTopologyNordStage 0 //!< Strip folded at the right end: even notes along the bottom, odd notes back along the top
+#define ledTopologyLinear 1 //!< One LED per key, from the lowest to the highest note
+
+#ifndef ledTopology
+#define ledTopology ledTopologyNordStage //!< Topology of the connected strip
+#endif
+
+#if ledTopology == ledTopologyNordStage
+#define ledTopologySegments(segment) \
+	segment(8, 2, 38)	/* Bottom row, left to right */ \
+	segment(83, -2, 40)	/* Top row, right to left */
+#elif ledTopology == ledTopologyLinear
+#define ledTopologySegments(segment) \
+	segment(0, 1, 88)
+#else
+#error "Unsupported ledTopology"
+#endif
+
+/** Segment of consecutive LEDs */
+typedef struct
+{
+	uint8_t firstNote; //!< Note (0 is the lowest key) lit by the first LED, or ledNoNote
+	int8_t noteStep; //!< Note difference between consecutive LEDs
+	uint8_t count; //!< Number of LEDs
+} LedSegment;
+
+#define ledSegmentCount(firstNote, noteStep, count) + (count)
+#define ledCount (0 ledTopologySegments(ledSegmentCount)) //!< Number of LEDs written to the strip
+
+#endif /* LEDTOPOLOGY_H_ */
@@ -9,21 +9,50 @@
 */
 
 #include "Model/ConfigurationModel.h"
+#include "Common/MidiParser.h"
 #include "globals.h"
 #include "midi.h"
 #include "ledstrip.h"
 #include "BV4513.h"
+#include "timer.h"
 #include <avr/io.h>
 
 unsigned char notes[88]; //!<Note velocity values
 unsigned char notesRelease[88]; //!<Note release velocity values
 unsigned char midiSustain; //!<Current value of sustain pedal
+unsigned char midiNotesOn = 0; //!<Number of notes currently on
+uint16_t midiPitchClasses = 0;
+uint8_t midiBassNote = midiNoNote;
+static uint8_t midiPitchClassCounts[12]; //!<Number of notes which are on, per pitch class
 unsigned char midiExpression = 0;
 
-static unsigned char midiChannel;
+/** Routing per MIDI channel (combination of midiRoute* flags). Messages of channels without any route are rejected by the receive interrupt. */
+static volatile uint8_t midiChannelRoutes[16];
 volatile unsigned int midiErrorCount = 0;
+volatile unsigned int midiOverflowCount = 0;
 
-enum midiReceiveStateEnum midiReceiveState = statusByte;
+/** Received MIDI byte, stamped with its arrival time. Only the low 16 bits of the timestamp are kept, which cover 26 ms. */
+typedef struct
+{
+	uint8_t byte;
+	uint16_t stamp;
+} midiRxByte;
+
+/** Received MIDI message, stamped with the arrival time of its last byte. */
+typedef struct
+{
+	MidiEvent_t event;
+	Timestamp_t timestamp;
+} midiTimedEvent;
+
+/** Byte queue, filled by the USART0 receive interrupt and drained by @ref midiProcessInput. */
+static volatile midiRxByte midiRxQueue[midiRxQueueSize];
+static volatile uint8_t midiRxHead = 0; //!<Next slot to write, only modified by the receive interrupt
+static volatile uint8_t midiRxTail = 0; //!<Next slot to read, only modified by the main loop
+static uint8_t midiRxRejecting = 0; //!<Whether data bytes are currently rejected, only used by the receive interrupt
+static MidiQueueFilter_t midiRxFilter; //!<Drops whole messages when the queue is full, only used by the receive interrupt
+
+static MidiParser_t midiParser; //!<Only used by the main loop
 
 #ifdef midiLogEnabled
 unsigned char midiBytes[midiLogSize];
@@ -40,11 +69,46 @@ unsigned int midiLogCount = 0;
 */
 void midiInit()
 {
-	//midiChannel = (PORTA && 0x0F);
-	midiChannel = 0;
+	midiSetChannelRouting(midiChannelOmni, 0);
+	midiSetChannelRouting(1<<midiDefaultChannel, midiRouteAll);
+	midiSetChannelRouting(midiSecondaryChannels, midiRouteNotes | midiRouteControllers | midiRoutePartB);
+	MidiParser_Initialize(&midiParser);
+	MidiParser_InitializeQueueFilter(&midiRxFilter);
 	midiUSART0Init();
 }
 /**
+* This method sets which messages of the given MIDI channels are passed to the LED effects.
+* @param channelMask Bit mask of the channels to set (bit 0 is channel 1), or midiChannelOmni.
+* @param routes Combination of midiRoute* flags, 0 to ignore the channels completely.
+*/
+void midiSetChannelRouting(uint16_t channelMask, uint8_t routes)
+{
+	for(uint8_t channel = 0; channel < 16; channel++)
+	{
+		if(channelMask & (1U<<channel))
+		{
+			midiChannelRoutes[channel] = routes;
+		}
+	}
+}
+/**
+* This method routes a channel as second part, e.g. the other section of a split keyboard. The channel which was routed this way before is ignored again.
+* @param channel Channel number (1 is MIDI channel 1), 0 to stop routing a channel as second part. The default channel is never changed.
+*/
+void midiSetSplitChannel(uint8_t channel)
+{
+	static uint8_t splitChannel = 0;
+	if(splitChannel != 0 && splitChannel - 1 != midiDefaultChannel)
+	{
+		midiSetChannelRouting(1U<<(splitChannel - 1), 0);
+	}
+	splitChannel = (channel <= 16) ? channel : 0;
+	if(splitChannel != 0 && splitChannel - 1 != midiDefaultChannel)
+	{
+		midiSetChannelRouting(1U<<(splitChannel - 1), midiRouteNotes | midiRouteControllers | midiRoutePartB);
+	}
+}
+/**
 * This method initializes USART0 for MIDI reception.
 * @author Daniël Schenk
 * @date 2011-09-30
@@ -56,158 +120,297 @@ void midiUSART0Init()
 	UBRR0 = (F_CPU/500000)-1;
 }
 /**
-* This method is designed for the interrupt based handling of MIDI bytes. It contains a state machine and therefore requires corresponding global variables.
+* This method is designed to be called from the USART0 receive interrupt. It only stores the received byte in the byte queue together with its arrival time, unless it belongs to a channel without any route. Parsing and all further processing is done from the main loop by @ref midiProcessInput.
 * @author Daniël Schenk
 * @date 2011-12-07
 */
-void midiHandleByte()
+void midiReceiveByte()
 {
-	static unsigned char currentParam; //!<Current note or controller number being handled
+	//Error flags are only valid until UDR0 is read
+	unsigned char errors = UCSR0A & (1<<FE0|1<<DOR0);
+	unsigned char midiReceiveBuffer = UDR0;
 
-	//Save received byte from USART0
-	unsigned char midiReceiveBuffer = UDR0; //!<To empty the USART receive register and save MIDI byte for use
+	if(errors)
+	{
+		midiReceiveBuffer = midiErrorMarker; //Make the parser drop the message in progress
+		midiErrorCount++;
+	}
 
 	#ifdef midiLogEnabled
 	midiLogByte(midiReceiveBuffer); //Record received byte for debugging purposes
 	#endif
 
-	//Extract the nibbles from received byte
-	volatile unsigned char midiLowerNibble = midiReceiveBuffer & 0x0F; //!<Lower nibble of received MIDI byte
-	volatile unsigned char midiUpperNibble = (midiReceiveBuffer & 0xF0)/16; //!<Upper nibble of received MIDI byte
-
-	if((UCSR0A & (1<<FE0|1<<DOR0)) == 0) //If received without errors
+	//Reject messages of channels without any route here already, so a busy stream of other channels takes no queue space. Only needs a check of status bytes.
+	if(midiReceiveBuffer & 0x80)
 	{
-		//To get out of the 'skip' state when a new status byte arrives
-		if(midiUpperNibble > 7)
+		if(midiReceiveBuffer >= 0xF8)
 		{
-			midiReceiveState = statusByte;
+			return; //Real-time messages are not used
 		}
+		midiRxRejecting = (midiReceiveBuffer < 0xF0) && (midiChannelRoutes[midiReceiveBuffer & 0x0F] == 0);
 	}
-	else
+	if(midiRxRejecting)
 	{
-		midiReceiveState = skip; //Do nothing with incorrectly received data
-		UCSR0A = (UCSR0A & (~(1<<FE0|1<<DOR0))); //Clear any errors
-		midiErrorCount++;
+		return;
 	}
 
-	//unsigned char dummy = 0;
+	//When the main loop is falling behind, the rest of the message which doesn't fit is dropped, so no data is taken for the wrong message
+	uint8_t head = midiRxHead;
+	uint8_t space = (midiRxTail - head - 1) & (midiRxQueueSize - 1);
+	uint8_t count = MidiParser_FilterQueued(&midiRxFilter, midiReceiveBuffer, space);
+	if(count == 0)
+	{
+		midiOverflowCount++;
+		return;
+	}
 
+	uint16_t stamp = (uint16_t)timerGetTimestamp();
+	if(count == 2)
+	{
+		//Repeat the running status, so the parser drops the incomplete message and continues with this one
+		midiRxQueue[head].byte = midiRxFilter.status;
+		midiRxQueue[head].stamp = stamp;
+		head = (head + 1) & (midiRxQueueSize - 1);
+	}
+	midiRxQueue[head].byte = midiReceiveBuffer;
+	midiRxQueue[head].stamp = stamp;
+	midiRxHead = (head + 1) & (midiRxQueueSize - 1);
+}
 
+/**
+* This method updates the harmony state when a note has been turned on. Must be called when the note was off before.
+* @param note Note number (0 is the lowest key).
+*/
+static void midiNoteSounding(uint8_t note)
+{
+	uint8_t pitchClass = midiPitchClass(note);
+	if(midiPitchClassCounts[pitchClass]++ == 0)
+		midiPitchClasses |= (1U<<pitchClass);
+	if(note < midiBassNote)
+		midiBassNote = note;
+	midiNotesOn++;
+}
 
-	switch(midiReceiveState)
+/**
+* This method updates the harmony state when a note has been turned off. Must be called after clearing the note.
+* @param note Note number (0 is the lowest key).
+*/
+static void midiNoteSilent(uint8_t note)
+{
+	uint8_t pitchClass = midiPitchClass(note);
+	if(--midiPitchClassCounts[pitchClass] == 0)
+		midiPitchClasses &= ~(1U<<pitchClass);
+	midiNotesOn--;
+	if(note == midiBassNote)
 	{
-		case statusByte:
-			if(midiLowerNibble != midiChannel) //When MIDI channel doesn't match
+		//Only releasing the bass needs a search, upward from the old bass
+		midiBassNote = midiNoNote;
+		for(uint8_t n = note + 1; n < 88; n++)
+		{
+			if(notes[n] != 0)
 			{
-				midiReceiveState = skip; //Do nothing
+				midiBassNote = n;
 				break;
 			}
+		}
+	}
+}
 
-			#if BUILD_DISPLAY
-			if (midiReceiveState != skip)
-			{
-				//midiIndicator(1);
-			}
-			#endif
+/**
+* This method returns the root of the chord which is currently played: the lowest pitch class, starting from the bass, which has a third (minor or major) and a fifth above it. Takes at most 12 steps.
+* @return Pitch class of the root (0 is C), the pitch class of the bass note if no triad is played, or midiNoNote if all notes are off.
+*/
+uint8_t midiChordRoot(void)
+{
+	if(midiBassNote == midiNoNote)
+		return midiNoNote;
 
-			switch(midiUpperNibble) //Determine what type of message is being received
+	uint8_t bass = midiPitchClass(midiBassNote);
+	//Rotate the set so the candidate root is bit 0
+	uint16_t rotated = ((midiPitchClasses >> bass) | (midiPitchClasses << (12 - bass))) & 0x0FFF;
+	uint8_t root = bass;
+	for(uint8_t i = 0; i < 12; i++)
+	{
+		if((rotated & 1) && (rotated & (1<<7)) && (rotated & (1<<3 | 1<<4)))
+			return root;
+		rotated = (rotated >> 1) | ((rotated & 1) << 11);
+		if(++root >= 12)
+			root = 0;
+	}
+	return bass;
+}
+
+/**
+* This method handles a NoteOn message. NoteOn with velocity 0 is handled as NoteOff, which is commonly used together with running status.
+* @param noteNr MIDI note number.
+* @param velocity Note velocity.
+* @param part Part which plays the note, 1 for channels routed with midiRoutePartB.
+*/
+static void midiHandleNoteOn(uint8_t noteNr, uint8_t velocity, uint8_t part)
+{
+	uint8_t note = noteNr - midiLowestNote;
+	if(!midiNoteNrMapped(note))
+		return;
+	if(velocity == 0)
+	{
+		bool wasOn = notes[note] != 0;
+		notes[note] = 0;
+		if(wasOn)
+			midiNoteSilent(note);
+		notesRelease[note] = midiDefaultReleaseVelocity;
+		ledRenderFromNoteOff(note);
+		return;
+	}
+	bool wasOn = notes[note] != 0;
+	notes[note] = velocity;
+	if(!wasOn)
+		midiNoteSounding(note);
+	ledRenderFromNoteOn(note, part);
+}
+
+/**
+* This method handles a NoteOff message.
+* @param noteNr MIDI note number.
+* @param velocity Release velocity.
+*/
+static void midiHandleNoteOff(uint8_t noteNr, uint8_t velocity)
+{
+	uint8_t note = noteNr - midiLowestNote;
+	if(!midiNoteNrMapped(note))
+		return;
+	bool wasOn = notes[note] != 0;
+	notes[note] = 0; //Note needs to be turned off
+	if(wasOn)
+		midiNoteSilent(note);
+	notesRelease[note] = velocity; //Save release velocity for later use
+	ledRenderFromNoteOff(note);
+}
+
+/**
+* This method handles a Control change message.
+* @param controller Controller number.
+* @param value Controller value.
+*/
+static void midiHandleControlChange(uint8_t controller, uint8_t value)
+{
+	switch(controller) //Determine what variable has to be changed according to received controller number
+	{
+		case 0x40: //Sustain pedal
+		{
+			bool wasDown = midiSustain != 0;
+			midiSustain = value;
+			//The effects only need to know when the pedal is pressed or released
+			if(wasDown != (value != 0))
+				ledRenderFromSustain(value);
+			break;
+		}
+		default:
+			break;
+		case 9: //Drawbar 1
+			if (ConfigurationModel_GetCurrentPreset() == 100)
 			{
-				case 0x09: //NoteOn message
-					midiReceiveState = noteNrOn;
-					break;
-				case 0x08: //NoteOff message
-					midiReceiveState = noteNrOff;
-					break;
-				case 0x0C: //Program change message
-					midiReceiveState = progChange;
-					break;
-				case 0x0B: //Control change message
-					midiReceiveState = controlChange;
-					break;
-				default: //In case of unknown or unimplemented status code
-					midiReceiveState = skip; //Do nothing
-					break;
+				ledSingleColorSetFull((value*2), -1, -1);
 			}
-			break; //Break case statusByte (overlapping)
-		case noteNrOn:
-			currentParam = midiReceiveBuffer-midiLowestNote;
-			midiReceiveState = velocityOn;
 			break;
-		case velocityOn:
-			if(!midiNoteNrMapped(currentParam))
-				break;
-			notes[currentParam] = midiReceiveBuffer;
-			ledRenderFromNoteOn(currentParam, ConfigurationModel_GetCurrentPreset());
-			midiReceiveState = skip; //Further data is useless
-			break;
-		case noteNrOff:
-			currentParam = midiReceiveBuffer-midiLowestNote;
-			midiReceiveState = velocityOff;
+		case 14: //Drawbar 2
+			if (ConfigurationModel_GetCurrentPreset() == 100)
+			{
+				ledSingleColorSetFull(-1, (value*2), -1);
+			}
 			break;
-		case velocityOff:
-			if(!midiNoteNrMapped(currentParam))
-				break;
-			notes[currentParam] = 0; //Note needs to be turned off
-			notesRelease[currentParam] = midiReceiveBuffer; //Save release velocity for later use
-			ledRenderFromNoteOff(currentParam, ConfigurationModel_GetCurrentPreset());
-			midiReceiveState = skip; //Further data is useless
+		case 15: //Drawbar 3
+			if (ConfigurationModel_GetCurrentPreset() == 100)
+			{
+				ledSingleColorSetFull(-1, -1, (value*2));
+			}
 			break;
-		case progChange:
-			ConfigurationModel_SetCurrentPreset(midiReceiveBuffer);
-			midiReceiveState = skip;
+		case 16: //Drawbar 4
+			if (ConfigurationModel_GetCurrentPreset() == 100)
+			{
+				//max = 2*value;
+// 				for (int ledNr=0; ledNr<ledsConnected; ledNr++)
+// 				{
+// 					ledsR[ledNr]=ledsR[ledNr]*(max/255);
+// 					ledsG[ledNr]=ledsR[ledNr]*(max/255);
+// 					ledsB[ledNr]=ledsR[ledNr]*(max/255);
+// 				}
+			}
+		case 11: /* Expression */
+			midiExpression = value;
 			break;
-		case controlChange:
-			currentParam = midiReceiveBuffer; //Save controller number for next state
-			midiReceiveState = controlValue;
+	}
+}
+
+/**
+* This method handles a complete MIDI message.
+* @param timedEvent The message and its arrival time.
+*/
+static void midiHandleEvent(const midiTimedEvent *timedEvent)
+{
+	const MidiEvent_t *event = &timedEvent->event;
+	uint8_t routes = midiChannelRoutes[event->status & 0x0F];
+	switch(event->status & 0xF0) //Determine what type of message is received
+	{
+		case 0x90:
+			if(routes & midiRouteNotes)
+			{
+				midiHandleNoteOn(event->data[0], event->data[1], (routes & midiRoutePartB) ? 1 : 0);
+				ledEventRendered(timedEvent->timestamp);
+			}
 			break;
-		case controlValue:
-			switch(currentParam) //Determine what variable has to be changed according to received controller number
+		case 0x80:
+			if(routes & midiRouteNotes)
 			{
-				case 0x40: //Sustain pedal
-					midiSustain = midiReceiveBuffer;
-					break;
-				default:
-					break;
-				case 9: //Drawbar 1
-					if (ConfigurationModel_GetCurrentPreset() == 100)
-					{
-						ledSingleColorSetFull((midiReceiveBuffer*2), -1, -1);
-					}
-					break;
-				case 14: //Drawbar 2
-					if (ConfigurationModel_GetCurrentPreset() == 100)
-					{
-						ledSingleColorSetFull(-1, (midiReceiveBuffer*2), -1);
-					}
-					break;
-				case 15: //Drawbar 3
-					if (ConfigurationModel_GetCurrentPreset() == 100)
-					{
-						ledSingleColorSetFull(-1, -1, (midiReceiveBuffer*2));
-					}
-					break;
-				case 16: //Drawbar 4
-					if (ConfigurationModel_GetCurrentPreset() == 100)
-					{
-						//max = 2*midiReceiveBuffer;
-// 						for (int ledNr=0; ledNr<ledsConnected; ledNr++)
-// 						{
-// 							ledsR[ledNr]=ledsR[ledNr]*(max/255);
-// 							ledsG[ledNr]=ledsR[ledNr]*(max/255);
-// 							ledsB[ledNr]=ledsR[ledNr]*(max/255);
-// 						}
-					}
-				case 11: /* Expression */
-					midiExpression = midiReceiveBuffer;
-					break;
+				midiHandleNoteOff(event->data[0], event->data[1]);
+				ledEventRendered(timedEvent->timestamp);
 			}
-			ledRenderFromSustain(ConfigurationModel_GetCurrentPreset(), midiSustain);
-			midiReceiveState = skip;
 			break;
-		case skip:
-			break; //This case can be escaped only by arrival of a new status byte
-		default:
+		case 0xC0:
+			if(routes & midiRouteProgramChange)
+				ConfigurationModel_SetCurrentPreset(event->data[0]);
+			break;
+		case 0xB0:
+			if(event->data[0] == midiSplitController && (routes & midiRouteProgramChange))
+				midiSetSplitChannel(event->data[1]);
+			else if(routes & midiRouteControllers)
+				midiHandleControlChange(event->data[0], event->data[1]);
 			break;
+		default: //Unused message type
+			break;
+	}
+}
+
+/**
+* This method returns whether there are received MIDI messages waiting to be handled by @ref midiProcessInput.
+*/
+bool midiEventsPending()
+{
+	return midiRxTail != midiRxHead;
+}
+
+/**
+* This method parses all MIDI bytes which were received since the last call, and handles the completed messages. Must be called from the main loop.
+*/
+void midiProcessInput()
+{
+	//Bytes which arrive meanwhile are left for the next call, so all handled bytes were received before now
+	uint8_t head = midiRxHead;
+	Timestamp_t now = timerGetTimestamp();
+	uint8_t tail = midiRxTail;
+	while(tail != head)
+	{
+		midiRxByte received = midiRxQueue[tail];
+		tail = (tail + 1) & (midiRxQueueSize - 1);
+		midiRxTail = tail; //Free the slot before handling, handling may take a while
+
+		midiTimedEvent timedEvent;
+		if(!MidiParser_Parse(&midiParser, received.byte, &timedEvent.event) || timedEvent.event.status >= 0xF0)
+		{
+			continue; //Message not complete yet, or system message (not used)
+		}
+		//Full arrival time from its low 16 bits, assuming the byte was received less than 26 ms ago
+		timedEvent.timestamp = now - (uint16_t)((uint16_t)now - received.stamp);
+		midiHandleEvent(&timedEvent);
 	}
 }
 
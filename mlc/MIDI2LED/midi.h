@@ -11,6 +11,7 @@
 #ifndef MIDI_H_
 #define MIDI_H_
 #include <inttypes.h>
+#include <stdbool.h>
 #include "ledstrip.h"
 
 
@@ -18,30 +19,44 @@
 #define midiLogSize 200
 #define midiLowestNote 21
 #define midiHighestNote 108
+#define midiDefaultChannel 0 //!< Channel which controls everything (0 is MIDI channel 1)
+#define midiSecondaryChannels 0x0000 //!< Mask of additional channels which play notes and controllers as second part, e.g. the other section of a split keyboard
+#define midiSplitController 85 //!< Control change on a channel with program change route which sets the second part channel (1-16, 0 for none)
+#define midiChannelOmni 0xFFFF //!< Channel mask which selects all channels
 
-enum midiReceiveStateEnum
-{
-	statusByte,
-	noteNrOn,
-	noteNrOff,
-	velocityOn,
-	velocityOff,
-	progChange,
-	controlChange,
-	controlValue,
-	skip,
-};
+#define midiRouteNotes 0x01 //!< Route NoteOn/NoteOff messages to the LED effects
+#define midiRouteControllers 0x02 //!< Route control change messages (pedals, drawbars) to the LED effects
+#define midiRouteProgramChange 0x04 //!< Route program change messages to the preset selection
+#define midiRoutePartB 0x08 //!< Notes are played by the second part of the effect, which lights them in other colors
+#define midiRouteAll (midiRouteNotes | midiRouteControllers | midiRouteProgramChange)
+
+#define midiDefaultReleaseVelocity 64 //!< Release velocity used for NoteOn messages with velocity 0
+#define midiRxQueueSize 64 //!< Size of the received byte queue, must be a power of two
+#define midiErrorMarker 0xF4 //!< Undefined status byte, passed to the parser in place of erroneous data
+#define midiNoNote 0xFF //!< Note number meaning no note, e.g. no bass note when all notes are off
+
+#define midiPitchClass(note) (((note) + 9) % 12) //!< Pitch class of a note (0 is C), note 0 is A
 
 extern unsigned char notes[88];
 extern unsigned char midiSustain;
+extern unsigned char midiNotesOn;
+extern uint16_t midiPitchClasses; //!< Bit per pitch class (bit 0 is C) of which a note is on
+extern uint8_t midiBassNote; //!< Lowest note which is on, or midiNoNote
 extern unsigned char midiExpression;
+extern volatile unsigned int midiErrorCount; //!< Number of bytes received with framing or overrun errors
+extern volatile unsigned int midiOverflowCount; //!< Number of times bytes were dropped because the receive queue was full
 
-void midiHandleByte();
+void midiReceiveByte();
+bool midiEventsPending();
+void midiProcessInput();
 void midiInit();
+void midiSetChannelRouting(uint16_t channelMask, uint8_t routes);
+void midiSetSplitChannel(uint8_t channel);
 void midiUSART0Init();
 void midiIndicator(unsigned char enable);
 
 void midiLogByte(unsigned char input);
 uint8_t midiNoteNrMapped(uint8_t note);
+uint8_t midiChordRoot(void);
 
 #endif /* MIDI_H_ */
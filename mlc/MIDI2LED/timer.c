@@ -11,6 +11,11 @@
 #include "timer.h"
 #include "ledstrip.h"
 #include <avr/io.h>
+#include <util/atomic.h>
+
+static volatile Tick_t timerTickCount = 0; //!< Number of ticks since start
+static volatile Timestamp_t timerTickTimestamp = 0; //!< Timestamp of the start of the current tick
+static volatile Micros_t timerTickMicros = 0; //!< Time in us of the start of the current tick
 
 void timerInit()
 {
@@ -20,3 +25,116 @@ void timerInit()
 	OCR1A = 0x61A7; //100 Hz with prescale 8
 }
 
+/**
+* This method advances the tick count. Must be called from the Timer1 compare match interrupt.
+*/
+void timerTick(void)
+{
+	timerTickCount++;
+	timerTickTimestamp += TIMER_COUNTS_PER_TICK;
+	timerTickMicros += TIMER_US_PER_TICK;
+}
+
+/**
+* This method returns the number of ticks since start. Can be called from any context.
+*/
+Tick_t timerGetTickCount(void)
+{
+	Tick_t ticks;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ticks = timerTickCount;
+	}
+	return ticks;
+}
+
+/**
+* This method returns a free-running timestamp with sub-tick resolution. Can be called from any context, including interrupts which run while a tick is pending.
+*/
+Timestamp_t timerGetTimestamp(void)
+{
+	Timestamp_t timestamp;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uint16_t count = TCNT1;
+		timestamp = timerTickTimestamp;
+		if(TIFR1 & (1<<OCF1A))
+		{
+			//Counter has wrapped, but the tick interrupt did not run yet. Read again, to be sure to have the value after the wrap.
+			count = TCNT1;
+			timestamp += TIMER_COUNTS_PER_TICK;
+		}
+		timestamp += count;
+	}
+	return timestamp;
+}
+
+/**
+* This method returns the time in microseconds since start, from the tick count and the Timer1 counter. Can be called from any context, including interrupts which run while a tick is pending.
+*/
+Micros_t timerGetMicros(void)
+{
+	Micros_t micros;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uint16_t count = TCNT1;
+		micros = timerTickMicros;
+		if(TIFR1 & (1<<OCF1A))
+		{
+			//Counter has wrapped, but the tick interrupt did not run yet. Read again, to be sure to have the value after the wrap.
+			count = TCNT1;
+			micros += TIMER_US_PER_TICK;
+		}
+		micros += TIMER_COUNTS_TO_US(count);
+	}
+	return micros;
+}
+
+/**
+* This method makes sure the CPU wakes up from sleep at the given time, also when that is before the next tick. Times after the next tick are left to the tick interrupt. Must be called with interrupts disabled, right before sleeping.
+* @param wakeAt Time in us at which the CPU must be awake
+* @return False when the time is due already or too close to get to sleep before it, then the caller must not sleep
+*/
+bool timerWakeAt(Micros_t wakeAt)
+{
+	if(TIFR1 & (1<<OCF1A))
+	{
+		//The pending tick interrupt wakes the CPU right away
+		return true;
+	}
+	uint16_t count = TCNT1;
+	int32_t remaining = (int32_t)(wakeAt - (timerTickMicros + TIMER_COUNTS_TO_US(count)));
+	if(remaining <= 0)
+	{
+		return false;
+	}
+	if(remaining >= (int32_t)TIMER_US_PER_TICK)
+	{
+		//Not before the next tick
+		return true;
+	}
+	//Rounded up to whole counts of 0.4 us, so the CPU never wakes too early
+	uint32_t wakeCount = count + (((uint16_t)remaining * 5U + 1) >> 1);
+	if(wakeCount >= TIMER_COUNTS_PER_TICK - 1)
+	{
+		return true;
+	}
+	OCR1B = (uint16_t)wakeCount;
+	TIFR1 = (1<<OCF1B); //Clear a stale compare match
+	TIMSK1 |= (1<<OCIE1B);
+	//The counter kept running while calculating. A match it already passed, or passes before the CPU sleeps, would only come one tick later.
+	if((TIFR1 & (1<<OCF1A)) || TCNT1 + TIMER_WAKE_MIN_LEAD >= wakeCount)
+	{
+		TIMSK1 &= ~(1<<OCIE1B);
+		return false;
+	}
+	return true;
+}
+
+/**
+* This method disarms the wake-up set by @ref timerWakeAt. Must be called from the Timer1 compare match B interrupt.
+*/
+void timerWakeUp(void)
+{
+	TIMSK1 &= ~(1<<OCIE1B);
+}
@@ -13,13 +13,34 @@
 #define TIMER_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
-#define TICKS_TO_MS(ticks) (ticks*10)
-#define MS_TO_TICKS(ms) (ms/10)
+#define TICKS_TO_MS(ticks) ((ticks)*10)
+#define MS_TO_TICKS(ms) ((ms)/10) //!< Truncates, use @ref Micros_t for timing finer than a tick
+#define MS_TO_US(ms) ((ms)*1000UL)
+
+#define TIMER_COUNTS_PER_TICK 25000UL //!< Timer1 counts per tick (100 Hz with CLK/8)
+#define TIMESTAMP_TO_US(timestamp) ((timestamp)*2/5) //!< Timer1 runs at 2.5 MHz
+#define TIMESTAMP_TO_CYCLES(timestamp) ((timestamp)*8) //!< CPU cycles, Timer1 runs at CLK/8
+#define TIMER_US_PER_TICK 10000UL //!< Microseconds per tick
+#define TIMER_COUNTS_TO_US(counts) (((uint32_t)(counts)*52429UL) >> 17) //!< Timer1 counts within a tick to us, exact without a division
+#define TIMER_WAKE_MIN_LEAD 8 //!< Minimum Timer1 counts (64 CPU cycles) between arming a wake-up and its compare match, to get to sleep before it
 
 typedef uint32_t Tick_t;
 
+/** Time in Timer1 counts (0.4 us), wraps after about 28 minutes. */
+typedef uint32_t Timestamp_t;
+
+/** Monotonic time in microseconds, wraps after about 71 minutes. Compare two values by the sign of their difference. */
+typedef uint32_t Micros_t;
+
 void timerInit();
+void timerTick(void);
+Tick_t timerGetTickCount(void);
+Timestamp_t timerGetTimestamp(void);
+Micros_t timerGetMicros(void);
+bool timerWakeAt(Micros_t wakeAt);
+void timerWakeUp(void);
 
 
 #endif /* TIMER_H_ */